@@ -0,0 +1,272 @@
+#include <cstring>
+#include <cctype>
+#include "analyze.h"
+
+// Plies searched per position unless set otherwise.
+#define DEFAULT_ANALYSIS_DEPTH 10
+
+/*
+ * Makes an analyzer with the given number of worker threads, each with its
+ * own single-threaded search and a hash table of hashMB megabytes.
+ */
+Analyzer::Analyzer(int numWorkers, int hashMB) {
+    depth = DEFAULT_ANALYSIS_DEPTH;
+    moveTime = 0;
+    probCut = DEFAULT_PROBCUT_THRESHOLD;
+    records = NULL;
+    nextToSearch = 0;
+    numRead = 0;
+    finished = false;
+    if (numWorkers < 1) numWorkers = 1;
+    for (int i = 0; i < numWorkers; i++) {
+        Worker *worker = new Worker(hashMB);
+        worker->analyzer = this;
+        worker->search.tt = &worker->tt;
+        workers.push_back(worker);
+    }
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&jobReady, NULL);
+    pthread_cond_init(&jobDone, NULL);
+}
+
+/*
+ * Destructor for the analyzer.
+ */
+Analyzer::~Analyzer() {
+    for (unsigned int i = 0; i < workers.size(); i++)
+        delete workers[i];
+    pthread_mutex_destroy(&lock);
+    pthread_cond_destroy(&jobReady);
+    pthread_cond_destroy(&jobDone);
+}
+
+/*
+ * Analyzes every position in the input and returns how many there were.
+ * The main thread reads input and writes results; it stops reading while
+ * the window of positions read but not yet written is full, so memory use
+ * doesn't depend on the size of the input.
+ */
+long Analyzer::run(FILE *in, FILE *out) {
+    start();
+    char text[ANALYSIS_LINE_MAX];
+    long line = 0;
+    while (fgets(text, sizeof(text), in)) {
+        line++;
+        bool tooLong = !strchr(text, '\n') && !feof(in);
+        if (tooLong) {
+            int c;
+            while ((c = getc(in)) != EOF && c != '\n') {}
+        }
+        char *start = text;
+        while (isspace((unsigned char) *start)) start++;
+        if (*start == '\0' || *start == '#') continue;
+
+        AnalysisJob *job = nextJob(out);
+        job->line = line;
+        job->state = (!tooLong && parse(text, job)) ? JOB_WAITING
+                                                    : JOB_INVALID;
+        submit();
+    }
+    return finish(out);
+}
+
+/*
+ * Analyzes every position in a position file, in the same way. Results
+ * are numbered by record, from 1.
+ */
+long Analyzer::run(PositionFile *in, FILE *out) {
+    start();
+    const PositionRecord *records = in->records();
+    for (size_t n = 0; n < in->size(); n++) {
+        AnalysisJob *job = nextJob(out);
+        job->line = n + 1;
+        job->side = recordToBoard(&records[n], &job->board);
+        job->state = JOB_WAITING;
+        submit();
+    }
+    return finish(out);
+}
+
+/*
+ * Sets up an empty window and starts the workers.
+ */
+void Analyzer::start() {
+    int windowSize = workers.size() * ANALYSIS_WINDOW_PER_WORKER;
+    window.assign(windowSize, AnalysisJob());
+    for (int i = 0; i < windowSize; i++)
+        window[i].state = JOB_FREE;
+    nextToSearch = 0;
+    numRead = 0;
+    numWritten = 0;
+    finished = false;
+
+    for (unsigned int i = 0; i < workers.size(); i++)
+        pthread_create(&workers[i]->thread, NULL, workerMain, workers[i]);
+}
+
+/*
+ * Writes out finished results in order until there is room in the window,
+ * and returns the slot for the next input position with the lock held.
+ * The caller fills it in and hands it over with submit().
+ */
+AnalysisJob *Analyzer::nextJob(FILE *out) {
+    int windowSize = window.size();
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (numWritten < numRead
+               && window[numWritten % windowSize].state >= JOB_DONE) {
+            AnalysisJob *job = &window[numWritten % windowSize];
+            write(out, job);
+            job->state = JOB_FREE;
+            numWritten++;
+        }
+        if (numRead - numWritten < windowSize) break;
+        pthread_cond_wait(&jobDone, &lock);
+    }
+    return &window[numRead % windowSize];
+}
+
+/*
+ * Makes the position from nextJob() available to the workers.
+ */
+void Analyzer::submit() {
+    numRead++;
+    skipInvalid();
+    pthread_cond_signal(&jobReady);
+    pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Moves nextToSearch past lines that aren't positions. This has to happen
+ * as soon as they are read: the writer frees such a line's slot without
+ * waiting for a worker, and a worker still pointing at the freed slot
+ * would take the next line to use it for this one. Called with the lock
+ * held.
+ */
+void Analyzer::skipInvalid() {
+    int windowSize = window.size();
+    while (nextToSearch < numRead
+           && window[nextToSearch % windowSize].state == JOB_INVALID)
+        nextToSearch++;
+}
+
+/*
+ * Lets the workers finish, writes out the rest and returns the number of
+ * positions read.
+ */
+long Analyzer::finish(FILE *out) {
+    int windowSize = window.size();
+    pthread_mutex_lock(&lock);
+    finished = true;
+    pthread_cond_broadcast(&jobReady);
+    while (numWritten < numRead) {
+        AnalysisJob *job = &window[numWritten % windowSize];
+        if (job->state < JOB_DONE) {
+            pthread_cond_wait(&jobDone, &lock);
+            continue;
+        }
+        write(out, job);
+        job->state = JOB_FREE;
+        numWritten++;
+    }
+    pthread_mutex_unlock(&lock);
+
+    for (unsigned int i = 0; i < workers.size(); i++)
+        pthread_join(workers[i]->thread, NULL);
+    fflush(out);
+    return numRead;
+}
+
+/*
+ * Entry point for a worker thread.
+ */
+void *Analyzer::workerMain(void *arg) {
+    Worker *worker = (Worker *) arg;
+    worker->analyzer->workerLoop(worker);
+    return NULL;
+}
+
+/*
+ * Takes positions in input order and searches them until the input is
+ * finished and nothing is left waiting.
+ */
+void Analyzer::workerLoop(Worker *worker) {
+    int windowSize = window.size();
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        skipInvalid();
+        if (nextToSearch == numRead) {
+            if (finished) break;
+            pthread_cond_wait(&jobReady, &lock);
+            continue;
+        }
+
+        AnalysisJob *job = &window[nextToSearch % windowSize];
+        nextToSearch++;
+        job->state = JOB_RUNNING;
+        pthread_mutex_unlock(&lock);
+
+        TimeManager *timer = NULL;
+        if (moveTime > 0) {
+            worker->timer.startFixed(moveTime);
+            timer = &worker->timer;
+        }
+        worker->search.probCut = probCut;
+        // Without a time limit nothing would stop the endgame solver, and
+        // its results aren't on the scale of a fixed-depth search, so only
+        // a timed analysis hands endgames to it.
+        worker->search.exactEmpties = timer ? DEFAULT_EXACT_EMPTIES : 0;
+        worker->search.wldEmpties = timer ? DEFAULT_WLD_EMPTIES : 0;
+        job->result = worker->search.run(&job->board, job->side, depth,
+                                         timer);
+
+        pthread_mutex_lock(&lock);
+        job->state = JOB_DONE;
+        pthread_cond_signal(&jobDone);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Reads a position and side to move from one input line. Returns false if
+ * the line isn't in the expected format.
+ */
+bool Analyzer::parse(char *text, AnalysisJob *job) {
+    PositionRecord record;
+    if (!recordFromLine(text, &record)) return false;
+    job->side = recordToBoard(&record, &job->board);
+    return true;
+}
+
+/*
+ * Writes one result line and, if there is a record file, the position with
+ * the best move and its score.
+ */
+void Analyzer::write(FILE *out, AnalysisJob *job) {
+    if (job->state == JOB_INVALID) {
+        fprintf(out, "%ld\terror\n", job->line);
+        return;
+    }
+
+    SearchResult *r = &job->result;
+    if (records) {
+        PositionRecord record;
+        recordFromBoard(&job->board, job->side, &record);
+        record.flags |= RECORD_MOVE | RECORD_VALUE;
+        record.move = (r->move < 0) ? RECORD_PASS : r->move;
+        record.value = r->score;
+        record.depth = r->depth;
+        records->write(&record);
+    }
+    fprintf(out, "%ld\t", job->line);
+    if (r->move < 0) fprintf(out, "pass");
+    else fprintf(out, "%d,%d", r->move % 8, r->move / 8);
+    fprintf(out, "\t%d\t%d\t%lu\t", r->score, r->depth,
+            (unsigned long) r->nodes);
+    for (int i = 0; i < r->pvLength; i++) {
+        if (i > 0) fputc(' ', out);
+        if (r->pv[i] < 0) fprintf(out, "pass");
+        else fprintf(out, "%d,%d", r->pv[i] % 8, r->pv[i] / 8);
+    }
+    fputc('\n', out);
+}
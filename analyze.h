@@ -0,0 +1,101 @@
+#ifndef __ANALYZE_H__
+#define __ANALYZE_H__
+
+#include <cstdio>
+#include <vector>
+#include <pthread.h>
+#include "common.h"
+#include "board.h"
+#include "search.h"
+#include "record.h"
+using namespace std;
+
+// Positions read ahead of the oldest one not yet written, per worker. This
+// and the workers' hash tables are all the memory a batch run needs.
+#define ANALYSIS_WINDOW_PER_WORKER 4
+
+// Longest input line accepted, including the newline.
+#define ANALYSIS_LINE_MAX 256
+
+// States of a position in the analysis window.
+#define JOB_FREE 0      // Slot unused
+#define JOB_WAITING 1   // Read, waiting for a worker
+#define JOB_RUNNING 2   // Being searched
+#define JOB_DONE 3      // Searched, waiting to be written out
+#define JOB_INVALID 4   // Input line could not be read as a position
+
+/*
+ * One input position and, once searched, its result.
+ */
+struct AnalysisJob {
+    long line;
+    int state;
+    Board board;
+    Side side;
+    SearchResult result;
+};
+
+/*
+ * Batch analysis: reads positions from a stream, searches them in parallel
+ * on a pool of worker threads, and writes the results out in input order.
+ *
+ * Each input line holds 64 square characters in the format of
+ * Board::setBoard() ('b' black, 'w' white, anything else empty), then
+ * whitespace and the side to move ("b"/"Black" or "w"/"White"). Blank
+ * lines and lines starting with '#' are skipped. The input can also be a
+ * position file, read in place without any parsing.
+ *
+ * Each output line is tab-separated: input line number, best move as
+ * "x,y" or "pass", score for the side to move, depth, nodes and the
+ * principal variation. A line that isn't a position gives "error". With
+ * a record file set, each result is also written there as the position
+ * annotated with its best move, score and depth.
+ */
+class Analyzer {
+
+public:
+    Analyzer(int workers, int hashMB);
+    ~Analyzer();
+
+    long run(FILE *in, FILE *out);
+    long run(PositionFile *in, FILE *out);
+
+    int depth;    // Plies searched per position
+    int moveTime; // Milliseconds per position, or 0 for a fixed depth
+                  // without the endgame solver
+    double probCut; // Search::probCut for every worker
+    PositionWriter *records; // Also writes each result here, if set
+
+private:
+    struct Worker {
+        Worker(int hashMB) : tt(hashMB) {}
+        Analyzer *analyzer;
+        Search search;
+        TranspositionTable tt;
+        TimeManager timer;
+        pthread_t thread;
+    };
+
+    vector<Worker *> workers;
+    vector<AnalysisJob> window;
+    long nextToSearch;  // Number of the next job a worker takes
+    long numRead;       // Jobs read so far
+    long numWritten;    // Jobs written out so far
+    bool finished;      // No more input
+
+    pthread_mutex_t lock;
+    pthread_cond_t jobReady;
+    pthread_cond_t jobDone;
+
+    void start();
+    AnalysisJob *nextJob(FILE *out);
+    void submit();
+    void skipInvalid();
+    long finish(FILE *out);
+    static void *workerMain(void *arg);
+    void workerLoop(Worker *worker);
+    static bool parse(char *text, AnalysisJob *job);
+    void write(FILE *out, AnalysisJob *job);
+};
+
+#endif
@@ -0,0 +1,414 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+#include "common.h"
+#include "board.h"
+#include "eval.h"
+
+// Positions the microbenchmarks cycle through, and calls per benchmark.
+#define NUM_POSITIONS 4096
+#define NUM_CALLS 4000000
+
+// Default perft depth from the start position.
+#define DEFAULT_PERFT_DEPTH 9
+
+static Board positions[NUM_POSITIONS];
+static Eval evals[NUM_POSITIONS];
+static Side sides[NUM_POSITIONS];
+
+// Keeps the compiler from optimizing the benchmarked calls away.
+static volatile long sink;
+
+/*
+ * Perft node counts from the start position, black to move, for depths 0
+ * to 12. A pass counts as a ply, and a finished game is a single leaf.
+ */
+static const uint64_t START_PERFT[13] = {
+    1, 4, 12, 56, 244, 1396, 8200, 55092, 390216, 3005288, 24571284,
+    212258800, 1939886636
+};
+
+/*
+ * Stored perft positions, one character per square from (0, 0) along each
+ * row: 'b' black, 'w' white, '-' empty. All but the first have passes or
+ * finished games within the given depth. The counts were checked against
+ * a perft over the square-by-square scan move generator.
+ */
+struct PerftPosition {
+    const char *name;
+    const char *squares;
+    Side side;
+    int depth;
+    uint64_t nodes;
+};
+
+static const PerftPosition PERFT_POSITIONS[] = {
+    { "perft_midgame",
+      "----b--------bbb-----bb---bbbwww--wwwwww--wbbw-w-w--------------",
+      BLACK, 6, 1547326 },
+    { "perft_lopsided",
+      "www----wwwwwwww-wbwwwww-wwwwwwbwwwwbww-bwwwbww--bbbbw----bbbw---",
+      BLACK, 7, 589276 },
+    { "perft_endgame",
+      "wbbww----wbbw-bw-bbwbbw-bbbbwbbb-bbbwwb-wbwwbww-bwwbwwww-wwwwwb-",
+      BLACK, 8, 2864382 },
+    { "perft_last_moves",
+      "bwwww---bbwbbb--bbbwbb-bbwbbwwbbbwbwbwbb-bwwwbw-bwwwwwwwwwbbbbbb",
+      BLACK, 9, 2572 }
+};
+
+#define NUM_PERFT_POSITIONS \
+    (int) (sizeof(PERFT_POSITIONS) / sizeof(PERFT_POSITIONS[0]))
+
+/*
+ * One benchmark result. count is calls or perft nodes; expected is the
+ * known-correct node count for perft, 0 for the microbenchmarks.
+ */
+struct BenchResult {
+    const char *name;
+    uint64_t count;
+    double ns;
+    uint64_t expected;
+};
+
+#define MAX_RESULTS 32
+
+static BenchResult results[MAX_RESULTS];
+static int numResults = 0;
+
+/*
+ * Nanoseconds on a monotonic clock.
+ */
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * Fills the position set by random play, at every stage of the game.
+ */
+static void makePositions() {
+    srand(1);
+    int n = 0;
+    while (n < NUM_POSITIONS) {
+        Board board;
+        Side side = BLACK;
+        while (!board.isDone() && n < NUM_POSITIONS) {
+            positions[n] = board;
+            evals[n].setBoard(&board);
+            sides[n] = side;
+            n++;
+
+            uint64_t moves = board.legalMoves(side);
+            if (moves) {
+                for (int k = rand() % popCount(moves); k > 0; k--)
+                    moves &= moves - 1;
+                board.makeMove(firstSquare(moves), side);
+            }
+            side = opponent(side);
+        }
+    }
+}
+
+/*
+ * Records one benchmark result.
+ */
+static void report(const char *name, uint64_t count, double ns,
+                   uint64_t expected) {
+    BenchResult result = { name, count, ns, expected };
+    results[numResults++] = result;
+}
+
+/*
+ * Counts the leaves of the game tree to the given depth. Passing uses up
+ * a ply; two passes in a row end the game, which counts as one leaf.
+ */
+static uint64_t perft(Board *board, Side side, int depth, bool passed) {
+    if (depth == 0) return 1;
+    uint64_t moves = board->legalMoves(side);
+    if (moves == 0) {
+        if (passed) return 1;
+        return perft(board, opponent(side), depth - 1, true);
+    }
+
+    uint64_t nodes = 0;
+    for (; moves; moves &= moves - 1) {
+        int sq = firstSquare(moves);
+        uint64_t flipped = board->makeMove(sq, side);
+        nodes += perft(board, opponent(side), depth - 1, false);
+        board->undoMove(sq, flipped, side);
+    }
+    return nodes;
+}
+
+/*
+ * Runs perft on one position and records its speed and count.
+ */
+static void benchPerft(const char *name, Board *board, Side side, int depth,
+                       uint64_t expected) {
+    double start = nowNs();
+    uint64_t nodes = perft(board, side, depth, false);
+    double ns = nowNs() - start;
+    report(name, nodes, ns, expected);
+}
+
+/*
+ * Move generation, move making, symmetries and copying on Board.
+ */
+static void benchBoard() {
+    double start = nowNs();
+    long sum = 0;
+    for (int i = 0; i < NUM_CALLS; i++) {
+        int n = i % NUM_POSITIONS;
+        sum += positions[n].hasMoves(sides[n]);
+    }
+    report("board_has_moves", NUM_CALLS, nowNs() - start, 0);
+
+    start = nowNs();
+    for (int i = 0; i < NUM_CALLS; i++) {
+        int n = i % NUM_POSITIONS;
+        sum += popCount(positions[n].legalMoves(sides[n]));
+    }
+    report("board_legal_moves", NUM_CALLS, nowNs() - start, 0);
+
+    start = nowNs();
+    for (int i = 0; i < NUM_CALLS; i++) {
+        int n = i % NUM_POSITIONS;
+        Move move(i % 8, (i / 8) % 8);
+        sum += positions[n].checkMove(&move, sides[n]);
+    }
+    report("board_check_move", NUM_CALLS, nowNs() - start, 0);
+
+    start = nowNs();
+    for (int i = 0; i < NUM_CALLS; i++) {
+        int n = i % NUM_POSITIONS;
+        sum += popCount(positions[n].flips(i % 64, sides[n]));
+    }
+    report("board_flips", NUM_CALLS, nowNs() - start, 0);
+
+    // Each position's first legal move, for the move-making benchmarks.
+    static int firstMove[NUM_POSITIONS];
+    for (int n = 0; n < NUM_POSITIONS; n++) {
+        uint64_t moves = positions[n].legalMoves(sides[n]);
+        firstMove[n] = moves ? firstSquare(moves) : -1;
+    }
+
+    // Positions where the side to move has to pass are skipped, so these
+    // count only the moves actually made.
+    uint64_t count = 0;
+    start = nowNs();
+    for (int i = 0; i < NUM_CALLS; i++) {
+        int n = i % NUM_POSITIONS;
+        if (firstMove[n] < 0) continue;
+        Board board = positions[n];
+        Move move(firstMove[n] % 8, firstMove[n] / 8);
+        board.doMove(&move, sides[n]);
+        sum += board.hashKey(BLACK);
+        count++;
+    }
+    report("board_copy_do_move", count, nowNs() - start, 0);
+
+    count = 0;
+    start = nowNs();
+    for (int i = 0; i < NUM_CALLS; i++) {
+        int n = i % NUM_POSITIONS;
+        if (firstMove[n] < 0) continue;
+        uint64_t flipped = positions[n].makeMove(firstMove[n], sides[n]);
+        sum += positions[n].hashKey(BLACK);
+        positions[n].undoMove(firstMove[n], flipped, sides[n]);
+        count++;
+    }
+    report("board_make_undo", count, nowNs() - start, 0);
+
+    start = nowNs();
+    for (int i = 0; i < NUM_CALLS; i++) {
+        int n = i % NUM_POSITIONS;
+        sum += transformDiscs(positions[n].pieces(sides[n]), i % 8);
+    }
+    report("board_transform", NUM_CALLS, nowNs() - start, 0);
+
+    start = nowNs();
+    for (int i = 0; i < NUM_CALLS; i++) {
+        int n = i % NUM_POSITIONS;
+        uint64_t own, opp;
+        sum += positions[n].canonical(sides[n], &own, &opp) + (own ^ opp);
+    }
+    report("board_canonical", NUM_CALLS, nowNs() - start, 0);
+
+    start = nowNs();
+    for (int i = 0; i < NUM_CALLS; i++) {
+        Board *board = positions[i % NUM_POSITIONS].copy();
+        sum += board->hashKey(BLACK);
+        delete board;
+    }
+    report("board_heap_copy", NUM_CALLS, nowNs() - start, 0);
+
+    sink = sum;
+}
+
+/*
+ * Evaluation, by the old square weights, the patterns, the whole-board
+ * terms and all together, and of many positions at once.
+ */
+static void benchEval() {
+    double start = nowNs();
+    long sum = 0;
+    for (int i = 0; i < NUM_CALLS; i++) {
+        int n = i % NUM_POSITIONS;
+        sum += positions[n].score(sides[n])
+            - positions[n].score(opponent(sides[n]));
+    }
+    report("eval_square_weights", NUM_CALLS, nowNs() - start, 0);
+
+    start = nowNs();
+    for (int i = 0; i < NUM_CALLS; i++) {
+        int n = i % NUM_POSITIONS;
+        sum += evals[n].patternScore(&positions[n], sides[n]);
+    }
+    report("eval_patterns", NUM_CALLS, nowNs() - start, 0);
+
+    start = nowNs();
+    for (int i = 0; i < NUM_CALLS; i++) {
+        int n = i % NUM_POSITIONS;
+        sum += Eval::termScore(&positions[n], sides[n]);
+    }
+    report("eval_terms", NUM_CALLS, nowNs() - start, 0);
+
+    start = nowNs();
+    for (int i = 0; i < NUM_CALLS; i++) {
+        int n = i % NUM_POSITIONS;
+        uint64_t own = positions[n].pieces(sides[n]);
+        uint64_t opp = positions[n].pieces(opponent(sides[n]));
+        sum += popCount(Eval::stableDiscs(own, opp));
+    }
+    report("eval_stability", NUM_CALLS, nowNs() - start, 0);
+
+    start = nowNs();
+    for (int i = 0; i < NUM_CALLS; i++) {
+        int n = i % NUM_POSITIONS;
+        sum += evals[n].score(&positions[n], sides[n]);
+    }
+    report("eval_full", NUM_CALLS, nowNs() - start, 0);
+
+    // The same scores with no Eval kept up to date: from scratch one at a
+    // time, then in batches with the scalar kernel and, if selected, the
+    // AVX2 one.
+    start = nowNs();
+    for (int i = 0; i < NUM_CALLS; i++) {
+        int n = i % NUM_POSITIONS;
+        Eval eval;
+        eval.setBoard(&positions[n]);
+        sum += eval.score(&positions[n], sides[n]);
+    }
+    report("eval_scratch", NUM_CALLS, nowNs() - start, 0);
+
+    static uint64_t black[NUM_POSITIONS], white[NUM_POSITIONS];
+    static int scores[NUM_POSITIONS];
+    for (int n = 0; n < NUM_POSITIONS; n++) {
+        black[n] = positions[n].pieces(BLACK);
+        white[n] = positions[n].pieces(WHITE);
+    }
+    SimdLevel level = simdLevel();
+    for (int kernel = 0; kernel < 2; kernel++) {
+        if (kernel == 1 && level != SIMD_AVX2) break;
+        setSimdLevel(kernel == 0 ? SIMD_SCALAR : SIMD_AVX2);
+        start = nowNs();
+        for (int i = 0; i < NUM_CALLS; i += NUM_POSITIONS) {
+            Eval::scoreBatch(black, white, sides, NUM_POSITIONS, scores);
+            sum += scores[NUM_POSITIONS - 1];
+        }
+        report(kernel == 0 ? "eval_batch_scalar" : "eval_batch_avx2",
+               NUM_CALLS / NUM_POSITIONS * NUM_POSITIONS, nowNs() - start, 0);
+    }
+    setSimdLevel(level);
+
+    sink = sum;
+}
+
+/*
+ * Prints the results as CSV, or as a JSON array of objects. per_second is
+ * calls or perft nodes per second; correct is only filled in for perft.
+ */
+static void printResults(bool json) {
+    if (!json) printf("benchmark,count,ns_per_call,per_second,correct\n");
+    else printf("[\n");
+    for (int i = 0; i < numResults; i++) {
+        BenchResult *r = &results[i];
+        double perCall = r->ns / r->count;
+        double perSecond = r->count * 1e9 / r->ns;
+        const char *correct = !r->expected ? ""
+            : (r->count == r->expected) ? "yes" : "no";
+        if (!json) {
+            printf("%s,%lu,%.2f,%.0f,%s\n", r->name,
+                   (unsigned long) r->count, perCall, perSecond, correct);
+            continue;
+        }
+        printf("  {\"benchmark\": \"%s\", \"count\": %lu, "
+               "\"ns_per_call\": %.2f, \"per_second\": %.0f", r->name,
+               (unsigned long) r->count, perCall, perSecond);
+        if (r->expected) printf(", \"correct\": %s", *correct == 'y'
+                                ? "true" : "false");
+        printf("}%s\n", (i + 1 < numResults) ? "," : "");
+    }
+    if (json) printf("]\n");
+}
+
+/*
+ * Benchmarks Board and Eval: perft from the start position and from the
+ * stored positions, checked against their known node counts, then
+ * microbenchmarks of move generation, moves, copies and evaluation.
+ * Exits with status 1 if any perft count is wrong. --simd picks the move
+ * generation kernels (scalar, sse2 or avx2) instead of the best available.
+ *
+ * usage: bench [--json] [--depth N] [--simd LEVEL]
+ */
+int main(int argc, char *argv[]) {
+    bool json = false;
+    int depth = DEFAULT_PERFT_DEPTH;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--json")) {
+            json = true;
+        } else if (!strcmp(argv[i], "--depth") && i + 1 < argc) {
+            depth = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--simd") && i + 1 < argc) {
+            const char *name = argv[++i];
+            int level = SIMD_SCALAR;
+            while (level < NUM_SIMD_LEVELS
+                   && strcmp(name, simdName((SimdLevel) level)))
+                level++;
+            if (!setSimdLevel((SimdLevel) level)) {
+                fprintf(stderr, "%s kernels not available\n", name);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "usage: %s [--json] [--depth N] [--simd LEVEL]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    Board start;
+    benchPerft("perft_start", &start, BLACK, depth,
+               (depth >= 0 && depth <= 12) ? START_PERFT[depth] : 0);
+    for (int i = 0; i < NUM_PERFT_POSITIONS; i++) {
+        const PerftPosition *p = &PERFT_POSITIONS[i];
+        char squares[64];
+        memcpy(squares, p->squares, 64);
+        Board board;
+        board.setBoard(squares);
+        benchPerft(p->name, &board, p->side, p->depth, p->nodes);
+    }
+
+    makePositions();
+    benchBoard();
+    benchEval();
+    printResults(json);
+
+    for (int i = 0; i < numResults; i++) {
+        if (results[i].expected && results[i].count != results[i].expected)
+            return 1;
+    }
+    return 0;
+}
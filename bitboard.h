@@ -0,0 +1,243 @@
+#ifndef __BITBOARD_H__
+#define __BITBOARD_H__
+
+#include <stdint.h>
+#include "tables.h"
+#include "simd.h"
+
+/*
+ * Bitboard helpers. Bit i of a bitboard is the square (i % 8, i / 8), which
+ * matches the x + 8*y indexing used by Board.
+ */
+
+// Every square except the x == 0 column and the x == 7 column respectively.
+static const uint64_t NOT_FILE_A = 0xfefefefefefefefe;
+static const uint64_t NOT_FILE_H = 0x7f7f7f7f7f7f7f7f;
+// The six inner columns; discs on the outer columns can't be flanked
+// horizontally, so horizontal and diagonal fills are restricted to these.
+static const uint64_t INNER_FILES = 0x7e7e7e7e7e7e7e7e;
+
+inline int popCount(uint64_t b) {
+    return __builtin_popcountll(b);
+}
+
+/*
+ * Index of the lowest set bit. Undefined for an empty bitboard.
+ */
+inline int firstSquare(uint64_t b) {
+    return __builtin_ctzll(b);
+}
+
+/*
+ * Returns the squares that complete a capture in the direction given by a
+ * left shift of s: empty squares reached from one of our discs through an
+ * unbroken run of at least one opponent disc. "pro" is the set of opponent
+ * discs the run may pass through, already masked against wrapping. This is
+ * a Kogge-Stone fill, so the run is extended by 1, 2 and then 4 squares.
+ */
+inline uint64_t movesLeft(uint64_t own, uint64_t pro, uint64_t empty,
+                          int s) {
+    uint64_t x = (own << s) & pro;
+    x |= pro & (x << s);
+    pro &= pro << s;
+    x |= pro & (x << (2 * s));
+    pro &= pro << (2 * s);
+    x |= pro & (x << (4 * s));
+    return (x << s) & empty;
+}
+
+/*
+ * Same as movesLeft, in the direction given by a right shift of s.
+ */
+inline uint64_t movesRight(uint64_t own, uint64_t pro, uint64_t empty,
+                           int s) {
+    uint64_t x = (own >> s) & pro;
+    x |= pro & (x >> s);
+    pro &= pro >> s;
+    x |= pro & (x >> (2 * s));
+    pro &= pro >> (2 * s);
+    x |= pro & (x >> (4 * s));
+    return (x >> s) & empty;
+}
+
+/*
+ * All legal moves for the side owning "own" against "opp", as one mask.
+ * This is the scalar reference; use legalMoveMask().
+ */
+inline uint64_t legalMoveMaskScalar(uint64_t own, uint64_t opp) {
+    uint64_t empty = ~(own | opp);
+    uint64_t inner = opp & INNER_FILES;
+    uint64_t moves = 0;
+    moves |= movesLeft(own, inner, empty, 1);   // +x
+    moves |= movesRight(own, inner, empty, 1);  // -x
+    moves |= movesLeft(own, opp, empty, 8);     // +y
+    moves |= movesRight(own, opp, empty, 8);    // -y
+    moves |= movesLeft(own, inner, empty, 7);   // -x +y
+    moves |= movesRight(own, inner, empty, 7);  // +x -y
+    moves |= movesLeft(own, inner, empty, 9);   // +x +y
+    moves |= movesRight(own, inner, empty, 9);  // -x -y
+    return moves;
+}
+
+/*
+ * All opponent discs flipped when the side owning "own" plays on square sq.
+ * Zero if the square is not a legal move (assuming it is empty). This is
+ * the scalar reference; use flipMask().
+ *
+ * Each direction is one lookup in RAY_MASKS: the first square along the ray
+ * that isn't an opponent disc closes the capture if it is ours, and the
+ * flips are the ray squares before it. Rays towards higher squares find
+ * that square as the lowest set bit, rays towards lower squares as the
+ * highest. Whether a capture closes is hard to predict, so this is done
+ * without branches.
+ */
+inline uint64_t flipMaskScalar(uint64_t own, uint64_t opp, int sq) {
+    uint64_t flips = 0;
+    for (int d = 0; d < 4; d++) {
+        uint64_t ray = RAY_MASKS[d][sq];
+        uint64_t stop = ray & ~opp;
+        uint64_t first = stop & (0 - stop);
+        uint64_t closed = 0 - (uint64_t) ((first & own) != 0);
+        flips |= ray & (first - 1) & closed;
+    }
+    for (int d = 4; d < NUM_DIRECTIONS; d++) {
+        uint64_t ray = RAY_MASKS[d][sq];
+        // With no stop on the ray, bit 0 is picked instead; it is then
+        // either off the ray or an opponent disc, so nothing is flipped.
+        uint64_t stop = (ray & ~opp) | 1;
+        uint64_t first = (uint64_t) 1 << (63 - __builtin_clzll(stop));
+        uint64_t closed = 0 - (uint64_t) ((first & own & ray) != 0);
+        flips |= ray & ~((first << 1) - 1) & closed;
+    }
+    return flips;
+}
+
+/*
+ * All legal moves for the side owning "own" against "opp", by the fastest
+ * kernel the CPU supports.
+ */
+inline uint64_t legalMoveMask(uint64_t own, uint64_t opp) {
+    return legalMovesKernel(own, opp);
+}
+
+/*
+ * The discs flipped by a move on sq, by the fastest kernel the CPU
+ * supports. Zero if the move is not legal.
+ */
+inline uint64_t flipMask(uint64_t own, uint64_t opp, int sq) {
+    return flipsKernel(own, opp, sq);
+}
+
+/*
+ * Every square next to one of the given squares, in any of the 8
+ * directions.
+ */
+inline uint64_t neighbours(uint64_t b) {
+    uint64_t east = (b << 1) & NOT_FILE_A;
+    uint64_t west = (b >> 1) & NOT_FILE_H;
+    uint64_t row = b | east | west;
+    return (row | (row << 8) | (row >> 8)) & ~b;
+}
+
+// The 8 symmetries of the board. A symmetry is any combination of these
+// bits, applied in this order: transpose, then mirror x, then mirror y.
+#define SYM_MIRROR_X 1
+#define SYM_MIRROR_Y 2
+#define SYM_TRANSPOSE 4
+#define NUM_SYMMETRIES 8
+
+/*
+ * Mirrors every row, so that (x, y) goes to (7 - x, y), by swapping bits
+ * 1, 2 and then 4 apart.
+ */
+inline uint64_t mirrorX(uint64_t b) {
+    b = ((b >> 1) & 0x5555555555555555) | ((b & 0x5555555555555555) << 1);
+    b = ((b >> 2) & 0x3333333333333333) | ((b & 0x3333333333333333) << 2);
+    return ((b >> 4) & 0x0f0f0f0f0f0f0f0f) | ((b & 0x0f0f0f0f0f0f0f0f) << 4);
+}
+
+/*
+ * Mirrors every column, so that (x, y) goes to (x, 7 - y): the rows are
+ * the bytes, so this is a byte swap.
+ */
+inline uint64_t mirrorY(uint64_t b) {
+    return __builtin_bswap64(b);
+}
+
+/*
+ * Flips the board about the diagonal through (0, 0) and (7, 7), so that
+ * (x, y) goes to (y, x). Each delta swap exchanges the bits of the masked
+ * squares with those 28, 14 and then 7 squares further on.
+ */
+inline uint64_t transpose(uint64_t b) {
+    uint64_t t = 0x0f0f0f0f00000000 & (b ^ (b << 28));
+    b ^= t ^ (t >> 28);
+    t = 0x3333000033330000 & (b ^ (b << 14));
+    b ^= t ^ (t >> 14);
+    t = 0x5500550055005500 & (b ^ (b << 7));
+    return b ^ t ^ (t >> 7);
+}
+
+/*
+ * Applies a symmetry to every square of a bitboard.
+ */
+inline uint64_t transformDiscs(uint64_t b, int sym) {
+    if (sym & SYM_TRANSPOSE) b = transpose(b);
+    if (sym & SYM_MIRROR_X) b = mirrorX(b);
+    if (sym & SYM_MIRROR_Y) b = mirrorY(b);
+    return b;
+}
+
+/*
+ * Where a symmetry takes one square. With x in the low 3 bits and y in the
+ * next 3, mirroring is an xor with 7 and transposing swaps the two.
+ */
+inline int transformSquare(int sq, int sym) {
+    if (sym & SYM_TRANSPOSE) sq = ((sq & 7) << 3) | (sq >> 3);
+    if (sym & SYM_MIRROR_X) sq ^= 7;
+    if (sym & SYM_MIRROR_Y) sq ^= 56;
+    return sq;
+}
+
+/*
+ * The square a symmetry takes to sq, which maps a move found in the
+ * transformed position back to the original one.
+ */
+inline int inverseSquare(int sq, int sym) {
+    if (sym & SYM_MIRROR_Y) sq ^= 56;
+    if (sym & SYM_MIRROR_X) sq ^= 7;
+    if (sym & SYM_TRANSPOSE) sq = ((sq & 7) << 3) | (sq >> 3);
+    return sq;
+}
+
+/*
+ * Replaces a position with its canonical form, the smallest of its 8
+ * symmetries ordered by own and then opp, and returns the symmetry that
+ * gives it. Every symmetry of a position has the same canonical form. The
+ * images are built from each other, two transposes and a few shifts and
+ * byte swaps in all, with no table lookups.
+ */
+inline int canonicalDiscs(uint64_t *own, uint64_t *opp) {
+    uint64_t o[NUM_SYMMETRIES], p[NUM_SYMMETRIES];
+    o[0] = *own;
+    p[0] = *opp;
+    o[SYM_TRANSPOSE] = transpose(o[0]);
+    p[SYM_TRANSPOSE] = transpose(p[0]);
+    for (int t = 0; t < NUM_SYMMETRIES; t += SYM_TRANSPOSE) {
+        o[t + SYM_MIRROR_X] = mirrorX(o[t]);
+        p[t + SYM_MIRROR_X] = mirrorX(p[t]);
+        o[t + SYM_MIRROR_Y] = mirrorY(o[t]);
+        p[t + SYM_MIRROR_Y] = mirrorY(p[t]);
+        o[t + 3] = mirrorY(o[t + SYM_MIRROR_X]);
+        p[t + 3] = mirrorY(p[t + SYM_MIRROR_X]);
+    }
+
+    int best = 0;
+    for (int s = 1; s < NUM_SYMMETRIES; s++)
+        if (o[s] < o[best] || (o[s] == o[best] && p[s] < p[best])) best = s;
+    *own = o[best];
+    *opp = p[best];
+    return best;
+}
+
+#endif
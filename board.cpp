@@ -1,15 +1,53 @@
 #include "board.h"
 
+/*
+ * Zobrist keys: one random number per disc colour and square, plus one for
+ * white to move. flip[i] turns a disc on square i over.
+ */
+struct ZobristKeys {
+    uint64_t disc[2][64];
+    uint64_t flip[64];
+    uint64_t whiteToMove;
+};
+
+/*
+ * The i-th output of splitmix64 from a fixed seed, so hashes are the same
+ * from run to run.
+ */
+constexpr uint64_t splitmix64(int i) {
+    uint64_t z = 0x9e3779b97f4a7c15 * (uint64_t) (i + 2);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys makeZobristKeys() {
+    ZobristKeys keys = {};
+    for (int i = 0; i < 64; i++) {
+        keys.disc[WHITE][i] = splitmix64(i);
+        keys.disc[BLACK][i] = splitmix64(64 + i);
+        keys.flip[i] = keys.disc[WHITE][i] ^ keys.disc[BLACK][i];
+    }
+    keys.whiteToMove = splitmix64(128);
+    return keys;
+}
+
+static constexpr ZobristKeys ZOBRIST = makeZobristKeys();
+static constexpr const uint64_t (&discKeys)[2][64] = ZOBRIST.disc;
+static constexpr const uint64_t (&flipKeys)[64] = ZOBRIST.flip;
+static constexpr uint64_t whiteToMoveKey = ZOBRIST.whiteToMove;
+
 /*
  * Make a standard 8x8 othello board and initialize it to the standard setup.
  */
 Board::Board() {
-    taken.set(3 + 8 * 3);
-    taken.set(3 + 8 * 4);
-    taken.set(4 + 8 * 3);
-    taken.set(4 + 8 * 4);
-    black.set(4 + 8 * 3);
-    black.set(3 + 8 * 4);
+    taken = 0;
+    black = 0;
+    hash = 0;
+    set(WHITE, 3, 3);
+    set(WHITE, 4, 4);
+    set(BLACK, 4, 3);
+    set(BLACK, 3, 4);
 }
 
 /*
@@ -25,20 +63,34 @@ Board *Board::copy() {
     Board *newBoard = new Board();
     newBoard->black = black;
     newBoard->taken = taken;
+    newBoard->hash = hash;
     return newBoard;
 }
 
+/*
+ * Returns 1 if square i is set in the bitboard b, 0 otherwise.
+ */
+static inline int bit(uint64_t b, int i) {
+    return (b >> i) & 1;
+}
+
 bool Board::occupied(int x, int y) {
-    return taken[x + 8*y];
+    return bit(taken, x + 8*y);
 }
 
 bool Board::get(Side side, int x, int y) {
-    return occupied(x, y) && (black[x + 8*y] == (side == BLACK));
+    return occupied(x, y) && (bit(black, x + 8*y) == (side == BLACK));
 }
 
 void Board::set(Side side, int x, int y) {
-    taken.set(x + 8*y);
-    black.set(x + 8*y, side == BLACK);
+    int sq = x + 8*y;
+    if (!bit(taken, sq)) hash ^= discKeys[side][sq];
+    else if (bit(black, sq) != (side == BLACK)) hash ^= flipKeys[sq];
+
+    uint64_t mask = (uint64_t) 1 << sq;
+    taken |= mask;
+    if (side == BLACK) black |= mask;
+    else black &= ~mask;
 }
 
 bool Board::onBoard(int x, int y) {
@@ -58,22 +110,60 @@ bool Board::isDone() {
  * Returns true if there are legal moves for the given side.
  */
 bool Board::hasMoves(Side side) {
+#ifdef SCAN_MOVEGEN
+    return scanMoves(side) != 0;
+#else
+    return legalMoves(side) != 0;
+#endif
+}
+
+/*
+ * Returns true if a move is legal for the given side; false otherwise.
+ */
+bool Board::checkMove(Move *m, Side side) {
+#ifdef SCAN_MOVEGEN
+    return checkMoveScan(m, side);
+#else
+    // Passing is only legal if you have no moves.
+    if (m == NULL) return !hasMoves(side);
+
+    int sq = m->getX() + 8 * m->getY();
+    return !bit(taken, sq) && flips(sq, side) != 0;
+#endif
+}
+
+/*
+ * Returns a mask of every legal move for the given side, computed with
+ * directional shifts over the whole board at once.
+ */
+uint64_t Board::legalMoves(Side side) {
+    uint64_t own = pieces(side);
+    return legalMoveMask(own, taken & ~own);
+}
+
+/*
+ * Returns the same mask as legalMoves(), built by checking each square in
+ * turn. Kept as a reference to cross-check the bitboard generator.
+ */
+uint64_t Board::scanMoves(Side side) {
+    uint64_t moves = 0;
     for (int i = 0; i < 8; i++) {
         for (int j = 0; j < 8; j++) {
             Move move(i, j);
-            if (checkMove(&move, side)) return true;
+            if (checkMoveScan(&move, side))
+                moves |= (uint64_t) 1 << (i + 8 * j);
         }
     }
-    return false;
+    return moves;
 }
 
 /*
- * Returns true if a move is legal for the given side; false otherwise.
+ * Square-by-square version of checkMove(), walking each of the 8 directions.
  */
-bool Board::checkMove(Move *m, Side side) {
-    
+bool Board::checkMoveScan(Move *m, Side side) {
+
     // Passing is only legal if you have no moves.
-    if (m == NULL) return !hasMoves(side);
+    if (m == NULL) return scanMoves(side) == 0;
 
     int X = m->getX();
     int Y = m->getY();
@@ -106,11 +196,74 @@ bool Board::checkMove(Move *m, Side side) {
  * Modifies the board to reflect the specified move.
  */
 void Board::doMove(Move *m, Side side) {
+#ifdef SCAN_MOVEGEN
+    doMoveScan(m, side);
+#else
+    // A NULL move means pass.
+    if (m == NULL) return;
+
+    // Ignore if move is invalid.
+    int sq = m->getX() + 8 * m->getY();
+    if (bit(taken, sq) || flips(sq, side) == 0) return;
+
+    makeMove(sq, side);
+#endif
+}
+
+/*
+ * Returns the discs flipped if the given side plays on square sq, computed
+ * for all 8 directions at once. Zero means the move is not legal; sq is
+ * assumed to be empty.
+ */
+uint64_t Board::flips(int sq, Side side) {
+    uint64_t own = pieces(side);
+    return flipMask(own, taken & ~own, sq);
+}
+
+/*
+ * Plays a legal move on square sq in place and returns the flipped discs,
+ * which undoMove() needs to take the move back.
+ */
+uint64_t Board::makeMove(int sq, Side side) {
+    uint64_t flipped = flips(sq, side);
+    uint64_t mask = (uint64_t) 1 << sq;
+    taken |= mask;
+    if (side == BLACK) black |= flipped | mask;
+    else black &= ~flipped;
+    updateHash(sq, flipped, side);
+    return flipped;
+}
+
+/*
+ * Applies a move on square sq that flips the given discs to the hash. The
+ * same call takes the move back out again.
+ */
+void Board::updateHash(int sq, uint64_t flipped, Side side) {
+    hash ^= discKeys[side][sq];
+    for (; flipped; flipped &= flipped - 1)
+        hash ^= flipKeys[firstSquare(flipped)];
+}
+
+/*
+ * Takes back a move made with makeMove().
+ */
+void Board::undoMove(int sq, uint64_t flipped, Side side) {
+    uint64_t mask = (uint64_t) 1 << sq;
+    taken &= ~mask;
+    if (side == BLACK) black &= ~(flipped | mask);
+    else black |= flipped;
+    updateHash(sq, flipped, side);
+}
+
+/*
+ * Square-by-square version of doMove(), flipping one disc at a time.
+ */
+void Board::doMoveScan(Move *m, Side side) {
     // A NULL move means pass.
     if (m == NULL) return;
 
     // Ignore if move is invalid.
-    if (!checkMove(m, side)) return;
+    if (!checkMoveScan(m, side)) return;
 
     int X = m->getX();
     int Y = m->getY();
@@ -142,6 +295,39 @@ void Board::doMove(Move *m, Side side) {
     set(side, X, Y);
 }
 
+/*
+ * Bitboard of the given side's stones.
+ */
+uint64_t Board::pieces(Side side) {
+    return (side == BLACK) ? black : taken & ~black;
+}
+
+/*
+ * Zobrist hash of the position with the given side to move.
+ */
+uint64_t Board::hashKey(Side toMove) {
+    return (toMove == WHITE) ? hash ^ whiteToMoveKey : hash;
+}
+
+/*
+ * Computes the Zobrist hash of the discs from scratch.
+ */
+uint64_t Board::computeHash() {
+    return hashDiscs(black, taken & ~black);
+}
+
+/*
+ * Zobrist hash of any set of black and white discs.
+ */
+uint64_t Board::hashDiscs(uint64_t black, uint64_t white) {
+    uint64_t h = 0;
+    for (uint64_t b = black; b; b &= b - 1)
+        h ^= discKeys[BLACK][firstSquare(b)];
+    for (uint64_t w = white; w; w &= w - 1)
+        h ^= discKeys[WHITE][firstSquare(w)];
+    return h;
+}
+
 /*
  * Current count of given side's stones.
  */
@@ -153,14 +339,14 @@ int Board::count(Side side) {
  * Current count of black stones.
  */
 int Board::countBlack() {
-    return black.count();
+    return popCount(black);
 }
 
 /*
  * Current count of white stones.
  */
 int Board::countWhite() {
-    return taken.count() - black.count();
+    return popCount(taken & ~black);
 }
 
 /*
@@ -174,78 +360,72 @@ int Board::score(Side side) {
  * Current score of black stones -- corners and sides are more valuable.
  */
 int Board::scoreBlack() {
-    // Start with the original score
-    int score = countBlack();
-    // Bonus for corners -- Corners are worth 10
-    score += 9 * (black[0] + black[7] + black[56] + black[63]);
-
-    // Bonus for edges -- Edges are worth 3
-    for (int i = 1; i < 7; i++) {
-        score += 2 * black[i]; // Top edge
-        score += 2 * black[56 + i]; // Bottom edge
-        score += 2 * black[i * 8]; // Left edge
-        score += 2 * black[i * 8 + 7]; // Right edge
-    }
-    // Penalty for edge piece adjacent to corner -- worth -3 total
-    for (int i = 0; i < 2; i++) {
-        // The adjacent pieces on the top and bottom edges
-        score -= 6 * black[56 * i + 1];
-        score -= 6 * black[56 * i + 6];
-        // The adjacent pieces on the left and right edges
-        score -= 6 * black[40 * i + 8];
-        score -= 6 * black[40 * i + 15];
-    }
-    // Penalty for piece diagonally adjacent to corner -- worth -10 total
-    score -= 11 * (black[9] + black[14] + black[49] + black[54]);
-
-    return score;
+    return squareScore(black);
 }
 
 /*
  * Current score of white stones -- corners and sides are more valuable.
  */
 int Board::scoreWhite() {
-    // Get bitset of white stones -- spots that are taken but not black
-    bitset<64> white = (taken & ~black);
-    // Start with the original score
-    int score = countWhite();
-    // Bonus for corners -- Corners are worth 10
-    score += 9 * (white[0] + white[7] + white[56] + white[63]);
-
-    // Bonus for edges -- Edges are worth 3
-    for (int i = 1; i < 7; i++) {
-        score += 2 * white[i]; // Top edge
-        score += 2 * white[56 + i]; // Bottom edge
-        score += 2 * white[i * 8]; // Left edge
-        score += 2 * white[i * 8 + 7]; // Right edge
-    }
-    // Penalty for edge piece adjacent to corner -- worth -3 total
-    for (int i = 0; i < 2; i++) {
-        // The adjacent pieces on the top and bottom edges
-        score -= 6 * white[56 * i + 1];
-        score -= 6 * white[56 * i + 6];
-        // The adjacent pieces on the left and right edges
-        score -= 6 * white[40 * i + 8];
-        score -= 6 * white[40 * i + 15];
-    }
-    // Penalty for piece diagonally adjacent to corner -- worth -10 total
-    score -= 11 * (white[9] + white[14] + white[49] + white[54]);
+    return squareScore(taken & ~black);
+}
 
+/*
+ * Sums SQUARE_WEIGHTS over the given discs.
+ */
+int Board::squareScore(uint64_t discs) {
+    int score = 0;
+    for (; discs; discs &= discs - 1)
+        score += SQUARE_WEIGHTS[firstSquare(discs)];
     return score;
 }
+
 /*
  * Sets the board state given an 8x8 char array where 'w' indicates a white
  * piece and 'b' indicates a black piece. Mainly for testing purposes.
  */
 void Board::setBoard(char data[]) {
-    taken.reset();
-    black.reset();
+    taken = 0;
+    black = 0;
     for (int i = 0; i < 64; i++) {
+        uint64_t mask = (uint64_t) 1 << i;
         if (data[i] == 'b') {
-            taken.set(i);
-            black.set(i);
+            taken |= mask;
+            black |= mask;
         } if (data[i] == 'w') {
-            taken.set(i);
+            taken |= mask;
         }
     }
+    hash = computeHash();
+}
+
+/*
+ * Sets the board state from the bitboards of both sides, which must not
+ * overlap.
+ */
+void Board::setPieces(uint64_t blackDiscs, uint64_t whiteDiscs) {
+    black = blackDiscs;
+    taken = blackDiscs | whiteDiscs;
+    hash = computeHash();
+}
+
+/*
+ * The canonical form of the position for the given side to move, as in
+ * canonicalDiscs(): sets own and opp to the discs of the side to move and
+ * its opponent in that form, and returns the symmetry that gives it. A
+ * move found there maps back here through inverseSquare().
+ */
+int Board::canonical(Side side, uint64_t *own, uint64_t *opp) {
+    *own = pieces(side);
+    *opp = pieces(opponent(side));
+    return canonicalDiscs(own, opp);
+}
+
+/*
+ * Applies one of the 8 symmetries to the position.
+ */
+void Board::transform(int sym) {
+    black = transformDiscs(black, sym);
+    taken = transformDiscs(taken, sym);
+    hash = computeHash();
 }
@@ -1,21 +1,29 @@
 #ifndef __BOARD_H__
 #define __BOARD_H__
 
-#include <bitset>
 #include <iostream>
+#include <stdint.h>
 #include "common.h"
+#include "bitboard.h"
 using namespace std;
 
+/*
+ * Define SCAN_MOVEGEN to have hasMoves(), checkMove() and doMove() use the
+ * original square-by-square scan instead of the bitboard move generator.
+ */
+
 class Board {
    
 private:
-    bitset<64> black;
-    bitset<64> taken;    
+    uint64_t black;
+    uint64_t taken;
+    uint64_t hash; // Zobrist hash of the discs, kept up to date by every move
        
     bool occupied(int x, int y);
     bool get(Side side, int x, int y);
     void set(Side side, int x, int y);
     bool onBoard(int x, int y);
+    void updateHash(int sq, uint64_t flipped, Side side);
       
 public:
     Board();
@@ -25,15 +33,30 @@ public:
     bool isDone();
     bool hasMoves(Side side);
     bool checkMove(Move *m, Side side);
+    bool checkMoveScan(Move *m, Side side);
+    uint64_t legalMoves(Side side);
+    uint64_t scanMoves(Side side);
     void doMove(Move *m, Side side);
+    void doMoveScan(Move *m, Side side);
+    uint64_t flips(int sq, Side side);
+    uint64_t makeMove(int sq, Side side);
+    void undoMove(int sq, uint64_t flipped, Side side);
+    uint64_t pieces(Side side);
+    uint64_t hashKey(Side toMove);
+    uint64_t computeHash();
+    static uint64_t hashDiscs(uint64_t black, uint64_t white);
     int count(Side side);
     int countBlack();
     int countWhite();
     int score(Side side);
     int scoreBlack();
     int scoreWhite();
+    static int squareScore(uint64_t discs);
+    int canonical(Side side, uint64_t *own, uint64_t *opp);
+    void transform(int sym);
 
     void setBoard(char data[]);
+    void setPieces(uint64_t blackDiscs, uint64_t whiteDiscs);
 };
 
 #endif
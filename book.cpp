@@ -0,0 +1,103 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "book.h"
+
+OpeningBook::OpeningBook() {
+    map = NULL;
+    mapSize = 0;
+    entries = NULL;
+    count = 0;
+}
+
+OpeningBook::~OpeningBook() {
+    close();
+}
+
+/*
+ * Maps a book file into memory, replacing any book already open. Returns
+ * false, leaving the book empty, if the file can't be read or isn't a book.
+ */
+bool OpeningBook::open(const char *filename) {
+    close();
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(BookHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+
+    BookHeader *header = (BookHeader *) data;
+    if (header->magic != BOOK_MAGIC || header->version != BOOK_VERSION
+        || sizeof(BookHeader) + (size_t) header->count * sizeof(BookEntry)
+            > (size_t) st.st_size) {
+        munmap(data, st.st_size);
+        return false;
+    }
+
+    map = data;
+    mapSize = st.st_size;
+    entries = (BookEntry *) (header + 1);
+    count = header->count;
+    return true;
+}
+
+/*
+ * Unmaps the book file, if one is open.
+ */
+void OpeningBook::close() {
+    if (map) munmap(map, mapSize);
+    map = NULL;
+    mapSize = 0;
+    entries = NULL;
+    count = 0;
+}
+
+/*
+ * Number of positions in the book.
+ */
+int OpeningBook::size() {
+    return count;
+}
+
+/*
+ * Looks up the position with the given side to move. On a hit, fills in
+ * entry with its move turned back into this position's orientation and
+ * returns true.
+ */
+bool OpeningBook::probe(Board *board, Side side, BookEntry *entry) {
+    if (count == 0) return false;
+    uint64_t own = board->pieces(side);
+    uint64_t opp = board->pieces(opponent(side));
+    int sym;
+    uint64_t key = canonicalKey(own, opp, &sym);
+
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (entries[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == count || entries[lo].key != key) return false;
+
+    // A hash collision could point at a move that isn't legal here.
+    *entry = entries[lo];
+    entry->move = inverseSquare(entry->move, sym);
+    return (legalMoveMask(own, opp) >> entry->move) & 1;
+}
+
+/*
+ * The book key of a position: the hash of its canonical form, with the
+ * side to move's discs hashed as black. sym is set to the symmetry that
+ * gives it.
+ */
+uint64_t OpeningBook::canonicalKey(uint64_t own, uint64_t opp, int *sym) {
+    *sym = canonicalDiscs(&own, &opp);
+    return Board::hashDiscs(own, opp);
+}
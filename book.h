@@ -0,0 +1,66 @@
+#ifndef __BOOK_H__
+#define __BOOK_H__
+
+#include <stdint.h>
+#include <cstddef>
+#include "common.h"
+#include "board.h"
+
+// Book file read at startup if it exists, and its header.
+#define BOOK_FILE "book.bin"
+#define BOOK_MAGIC 0x4248544f // "OTHB" read as a little-endian word
+#define BOOK_VERSION 2
+
+/*
+ * File header: magic, version, number of entries and a spare word.
+ */
+struct BookHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+/*
+ * One book position. key is the canonical hash of the position for the
+ * side to move; move is in the same canonical orientation, and score is
+ * from the side to move's point of view, from a search to the given depth.
+ * Entries are sorted by key.
+ */
+struct BookEntry {
+    uint64_t key;
+    int16_t score;
+    uint8_t move;
+    uint8_t depth;
+    uint32_t reserved;
+};
+
+/*
+ * Read-only opening book. The file is mapped into memory and searched in
+ * place, so opening even a large book costs next to nothing. Positions are
+ * stored once for all 8 symmetries and both colours: the key is the
+ * Zobrist hash of the canonical form of the position (Board::canonical()),
+ * with the side to move's discs hashed as black and the opponent's as
+ * white.
+ */
+class OpeningBook {
+
+public:
+    OpeningBook();
+    ~OpeningBook();
+
+    bool open(const char *filename);
+    void close();
+    int size();
+    bool probe(Board *board, Side side, BookEntry *entry);
+
+    static uint64_t canonicalKey(uint64_t own, uint64_t opp, int *sym);
+
+private:
+    void *map;
+    size_t mapSize;
+    BookEntry *entries;
+    int count;
+};
+
+#endif
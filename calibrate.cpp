@@ -0,0 +1,161 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include "common.h"
+#include "board.h"
+#include "search.h"
+#include "probcut.h"
+
+// Fewest samples a fit needs; pairs with less data stay uncalibrated.
+#define MIN_SAMPLES 20
+
+// Plies of random moves at the start of each sample game; the rest of the
+// game is played by a shallow search.
+#define RANDOM_PLIES 8
+#define PLAY_DEPTH 2
+
+// Range of empty squares the sample positions are taken from.
+#define MIN_SAMPLE_EMPTIES 12
+#define MAX_SAMPLE_EMPTIES 52
+
+/*
+ * Running sums for a least squares fit of deep = a * shallow + b.
+ */
+struct Regression {
+    double n, x, y, xx, xy, yy;
+};
+
+/*
+ * Plays a sample game from the start to the given number of empties and
+ * returns the side to move, or leaves the board short of it if the game
+ * ends first.
+ */
+static Side samplePosition(Search *player, Board *board, int empties) {
+    Side side = BLACK;
+    for (int ply = 0; 64 - board->count(BLACK) - board->count(WHITE) > empties
+         && !board->isDone(); ply++) {
+        uint64_t moves = board->legalMoves(side);
+        if (moves) {
+            int sq;
+            if (ply < RANDOM_PLIES) {
+                for (int k = rand() % popCount(moves); k > 0; k--)
+                    moves &= moves - 1;
+                sq = firstSquare(moves);
+            }
+            else {
+                sq = player->run(board, side, PLAY_DEPTH).move;
+            }
+            board->makeMove(sq, side);
+        }
+        side = opponent(side);
+    }
+    return side;
+}
+
+/*
+ * Fits one check from its sums. Leaves it uncalibrated without enough
+ * data.
+ */
+static void fit(Regression *r, ProbCutCheck *check) {
+    double det = r->n * r->xx - r->x * r->x;
+    if (r->n < MIN_SAMPLES || det <= 0) return;
+    double a = (r->n * r->xy - r->x * r->y) / det;
+    double b = (r->y - a * r->x) / r->n;
+    double sse = r->yy - a * r->xy - b * r->y;
+    check->a = a;
+    check->b = b;
+    check->sigma = sqrt((sse > 0 ? sse : 0) / (r->n - 2));
+}
+
+/*
+ * Regenerates the Multi-ProbCut parameters. Positions come from self-play
+ * games that open with random moves; each one is searched to every depth
+ * up to the given one without pruning, and the scores of each depth pair
+ * used by a check are fitted per game phase by linear regression.
+ *
+ * The parameters are written to the file, and printed in the form of the
+ * built-in table in probcut.cpp.
+ *
+ * usage: calibrate [positions] [depth] [file]
+ */
+int main(int argc, char *argv[]) {
+    int positions = (argc > 1) ? atoi(argv[1]) : 500;
+    int maxDepth = (argc > 2) ? atoi(argv[2]) : 10;
+    const char *filename = (argc > 3) ? argv[3] : PROBCUT_FILE;
+    if (maxDepth > PROBCUT_MAX_DEPTH) maxDepth = PROBCUT_MAX_DEPTH;
+
+    Eval::loadWeights(WEIGHTS_FILE);
+    TranspositionTable tt(DEFAULT_TT_MB);
+    Search search;
+    search.tt = &tt;
+    search.probCut = 0;
+    search.exactEmpties = search.wldEmpties = 0;
+    Search player;
+    player.probCut = 0;
+    player.exactEmpties = player.wldEmpties = 0;
+    srand(1);
+
+    static Regression sums[NUM_PHASES][PROBCUT_MAX_DEPTH + 1][PROBCUT_CHECKS];
+    for (int n = 0; n < positions; n++) {
+        Board board;
+        int empties = MIN_SAMPLE_EMPTIES
+            + rand() % (MAX_SAMPLE_EMPTIES - MIN_SAMPLE_EMPTIES + 1);
+        Side side = samplePosition(&player, &board, empties);
+        if (board.isDone() || !board.legalMoves(side)) continue;
+
+        // Scores of decided games say nothing about the evaluation.
+        int scores[PROBCUT_MAX_DEPTH + 1];
+        int depth;
+        for (depth = 1; depth <= maxDepth && depth <= empties; depth++) {
+            tt.clear();
+            SearchResult result = search.run(&board, side, depth);
+            if (result.depth != depth || abs(result.score) >= WIN_SCORE)
+                break;
+            scores[depth] = result.score;
+        }
+
+        int phase = Eval::phase(&board);
+        for (int deep = PROBCUT_MIN_DEPTH; deep < depth; deep++) {
+            for (int i = 0; i < PROBCUT_CHECKS; i++) {
+                int shallow = ProbCut::shallowDepth(deep, i);
+                if (!shallow) continue;
+                Regression *r = &sums[phase][deep][i];
+                double x = scores[shallow], y = scores[deep];
+                r->n++;
+                r->x += x;
+                r->y += y;
+                r->xx += x * x;
+                r->xy += x * y;
+                r->yy += y * y;
+            }
+        }
+        if ((n + 1) % 50 == 0)
+            fprintf(stderr, "%d of %d positions\n", n + 1, positions);
+    }
+
+    ProbCut::clear();
+    for (int phase = 0; phase < NUM_PHASES; phase++)
+        for (int deep = PROBCUT_MIN_DEPTH; deep <= maxDepth; deep++)
+            for (int i = 0; i < PROBCUT_CHECKS; i++)
+                if (ProbCut::shallowDepth(deep, i))
+                    fit(&sums[phase][deep][i], ProbCut::entry(phase, deep, i));
+    if (!ProbCut::save(filename)) {
+        fprintf(stderr, "could not write %s\n", filename);
+        return 1;
+    }
+
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+        printf("    { // phase %d\n", phase);
+        for (int deep = PROBCUT_MIN_DEPTH; deep <= maxDepth; deep++) {
+            printf("        {");
+            for (int i = 0; i < PROBCUT_CHECKS; i++) {
+                ProbCutCheck *c = ProbCut::entry(phase, deep, i);
+                printf(" { %.3ff, %.2ff, %.2ff }%s", c->a, c->b, c->sigma,
+                       i + 1 < PROBCUT_CHECKS ? "," : "");
+            }
+            printf(" }%s\n", deep < maxDepth ? "," : "");
+        }
+        printf("    }%s\n", phase + 1 < NUM_PHASES ? "," : "");
+    }
+    return 0;
+}
@@ -5,6 +5,10 @@ enum Side {
     WHITE, BLACK
 };
 
+inline Side opponent(Side side) {
+    return (side == BLACK) ? WHITE : BLACK;
+}
+
 class Move {
    
 public:
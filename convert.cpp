@@ -0,0 +1,99 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include "common.h"
+#include "board.h"
+#include "record.h"
+
+// Longest text line read, including the newline.
+#define LINE_MAX_LENGTH 512
+
+/*
+ * Converts between position files and the two text formats: lines of
+ * positions in the analysis input format, and games in move notation
+ * ("f5d6c3...") one per line. Text is read from a file or "-" for stdin,
+ * and written to stdout. Lines that can't be read are reported and
+ * skipped; blank lines and lines starting with '#' are ignored.
+ *
+ * usage: convert --from-positions TEXT FILE
+ *        convert --from-games TEXT FILE
+ *        convert --to-positions FILE
+ *        convert --to-games FILE
+ */
+int main(int argc, char *argv[]) {
+    bool fromText = argc == 4 && (!strcmp(argv[1], "--from-positions")
+                                  || !strcmp(argv[1], "--from-games"));
+    bool toText = argc == 3 && (!strcmp(argv[1], "--to-positions")
+                                || !strcmp(argv[1], "--to-games"));
+    if (!fromText && !toText) {
+        fprintf(stderr, "usage: %s --from-positions TEXT FILE\n"
+                "       %s --from-games TEXT FILE\n"
+                "       %s --to-positions FILE\n"
+                "       %s --to-games FILE\n", argv[0], argv[0], argv[0],
+                argv[0]);
+        return 1;
+    }
+
+    if (toText) {
+        PositionFile file;
+        if (!file.open(argv[2])) {
+            fprintf(stderr, "could not read %s\n", argv[2]);
+            return 1;
+        }
+        const PositionRecord *records = file.records();
+        if (!strcmp(argv[1], "--to-games")) {
+            char text[GAME_TEXT_MAX];
+            for (size_t n = 0; n < file.size(); ) {
+                n += gameToText(records + n, file.size() - n, text);
+                printf("%s\n", text);
+            }
+            return 0;
+        }
+        for (size_t n = 0; n < file.size(); n++) {
+            char text[RECORD_LINE_LENGTH];
+            recordToLine(&records[n], text);
+            printf("%s\n", text);
+        }
+        return 0;
+    }
+
+    FILE *in = strcmp(argv[2], "-") ? fopen(argv[2], "r") : stdin;
+    if (!in) {
+        fprintf(stderr, "could not open %s\n", argv[2]);
+        return 1;
+    }
+    PositionWriter writer;
+    if (!writer.open(argv[3])) {
+        fprintf(stderr, "could not open %s\n", argv[3]);
+        return 1;
+    }
+    bool games = !strcmp(argv[1], "--from-games");
+    char text[LINE_MAX_LENGTH];
+    long line = 0, written = 0;
+    while (fgets(text, sizeof(text), in)) {
+        line++;
+        char *start = text;
+        while (isspace((unsigned char) *start)) start++;
+        if (*start == '\0' || *start == '#') continue;
+
+        PositionRecord records[60];
+        int count = games ? gameFromText(start, records, 60)
+            : recordFromLine(start, records) ? 1 : -1;
+        if (count < 0) {
+            fprintf(stderr, "line %ld: not a %s\n", line,
+                    games ? "game" : "position");
+            continue;
+        }
+        for (int i = 0; i < count; i++)
+            writer.write(&records[i]);
+        written += count;
+    }
+    if (in != stdin) fclose(in);
+    if (!writer.close()) {
+        fprintf(stderr, "could not write %s\n", argv[3]);
+        return 1;
+    }
+    printf("%ld positions written to %s\n", written, argv[3]);
+    return 0;
+}
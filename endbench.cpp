@@ -0,0 +1,152 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "common.h"
+#include "board.h"
+#include "endgame.h"
+#include "timeman.h"
+#include "tt.h"
+
+/*
+ * Endgame test positions in the style of the FFO suite, each with 20
+ * empties: one character per square from (0, 0) along each row, 'b'
+ * black, 'w' white, '-' empty, then the side to move and the final disc
+ * difference for it with perfect play. They come from engine games after a
+ * few random opening moves, kept if the result was within 16 discs; every
+ * other one has the colours swapped.
+ */
+struct EndgamePosition {
+    const char *name;
+    const char *squares;
+    Side side;
+    int score;
+};
+
+static const EndgamePosition POSITIONS[] = {
+    { "end20_01",
+      "w-ww-b--wwwwbb--wbbbbbb-wwwwbb--wbwwbw--wbbwbb--w-wbw---w-wwww--",
+      BLACK, -4 },
+    { "end20_02",
+      "--wwwww---wwww-wwwwwwbww-bbwwwbwbbbbwbwwbbbbbwww--bb---w--------",
+      WHITE, 8 },
+    { "end20_03",
+      "--w--b-b--wwbb-b-wwwwbwb--wbbwwb-wwbwwww--bbwbwb-bbbbw---wwwww--",
+      BLACK, 14 },
+    { "end20_04",
+      "wwwwww---wwwwwb--wwwwbwwwwwwbww-wbwbww--wwbbwww-w-wb------w-b---",
+      WHITE, -2 },
+    { "end20_05",
+      "--w-bbb-wwwbw---wwwbbww-wbbbwbb-wwbwwbb-wbwwbb--wwwwb---w-ww----",
+      BLACK, -2 },
+    { "end20_06",
+      "w--bww---wbwww-wwwwwbbbwwwbbbbbwwwbbbbbw-wbbbb-w--bbb------b----",
+      WHITE, -12 },
+    { "end20_07",
+      "-------------wwbbbbbbbbbbbwbwbbbbwwwwbbbbbwwbbbbb-wbbbbb-----b-b",
+      BLACK, 10 },
+    { "end20_08",
+      "--wwwww---wbbb--bbbbbbbbbbwbwwb-bwwwwb--bbwwbw--b-bbbw-----bb-w-",
+      WHITE, 4 },
+    { "end20_09",
+      "-wwwww--b-wbbw--bbbwbw--bbwwww--bbwbww-wbbbbbbw---wwww----wwww--",
+      BLACK, 16 },
+    { "end20_10",
+      "--w-bb----w-bb--wwwbbbb-wwbbbbbbwbwwbbb-bbbwwwww--wwww-----wwww-",
+      WHITE, 4 },
+    { "end20_11",
+      "--w--w----wwww--bbbwwbbb-bwwwwbbbbbbbwb-wwbwbwww--wbbb-w--b-bw--",
+      BLACK, 2 },
+    { "end20_12",
+      "--b-w----bbbww-w--bwwbww--bwwbbw--wwbbbwbbbbbbbw--wwwbb--wwww-b-",
+      WHITE, 4 },
+    { "end20_13",
+      "-----w--b----w-wbbbbwwwwbwbbwwbwbwwwbwwwbwwwbbbw--wwwwb----wbw--",
+      BLACK, 10 },
+    { "end20_14",
+      "--wwwww-b-wwbb--bbwbbbwwbwbbwbwwbbbbwwbwbbbbbbbwb------w--------",
+      WHITE, -2 },
+    { "end20_15",
+      "---------wbbb----bwbwww-bbbwbwbbbbbwwwbbbbbwwwbb--wbww-b--wwwww-",
+      BLACK, -14 },
+    { "end20_16",
+      "----------b--w--bbbbwww-bwbwbwwwbbbbwbwwbbbbbwbw--wbwwwb--bbww-w",
+      WHITE, -8 },
+    { "end20_17",
+      "---bww----bbwww---bwbww--bwwwwww--wwbbbb--wbbbbb--wwbbb--bbbbbbb",
+      BLACK, 0 },
+    { "end20_18",
+      "--bbbbb--wbbbb--wwwbbbwwwwbwbbwwwbbwbbbwwwbbbbbw--b-b-----------",
+      WHITE, -12 },
+    { "end20_19",
+      "-www---b--bbbbbbwwbbbwwbwwbbbwbbwbbwwbbbwbwwbbb-w-ww------------",
+      BLACK, -16 },
+    { "end20_20",
+      "--bwwb----wbwbb---wwwbww-wwwbbwwbbwbbbw--bbwbww---bbww----bbbbb-",
+      WHITE, -6 }
+};
+
+#define NUM_ENDGAME_POSITIONS \
+    (int) (sizeof(POSITIONS) / sizeof(POSITIONS[0]))
+
+/*
+ * Solves the 20-empties positions one after another, each with a cleared
+ * transposition table, and prints the nodes and time each took as CSV,
+ * then the totals. The --no-* flags turn off the solver's table (and so
+ * the enhanced transposition cutoffs with it), just the enhanced cutoffs,
+ * or the stability cutoffs, to measure what each saves. --wld solves for
+ * win/loss/draw only. Exits with status 1 if any result is wrong.
+ *
+ * usage: endbench [--wld] [--no-tt] [--no-etc] [--no-stability]
+ */
+int main(int argc, char *argv[]) {
+    bool wld = false;
+    bool useTT = true;
+    Endgame endgame;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--wld")) {
+            wld = true;
+        } else if (!strcmp(argv[i], "--no-tt")) {
+            useTT = false;
+        } else if (!strcmp(argv[i], "--no-etc")) {
+            endgame.enhancedCutoffs = false;
+        } else if (!strcmp(argv[i], "--no-stability")) {
+            endgame.stabilityCutoffs = false;
+        } else {
+            fprintf(stderr, "usage: %s [--wld] [--no-tt] [--no-etc]"
+                    " [--no-stability]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    TranspositionTable tt(DEFAULT_TT_MB);
+    if (useTT) endgame.tt = &tt;
+
+    printf("position,score,correct,nodes,ms,nodes_per_second\n");
+    uint64_t totalNodes = 0;
+    double totalMs = 0;
+    int wrong = 0;
+    for (int i = 0; i < NUM_ENDGAME_POSITIONS; i++) {
+        const EndgamePosition *p = &POSITIONS[i];
+        char squares[64];
+        memcpy(squares, p->squares, 64);
+        Board board;
+        board.setBoard(squares);
+        tt.clear();
+
+        long start = nowUs();
+        EndgameResult result = endgame.solve(&board, p->side, wld);
+        double ms = (nowUs() - start) / 1e3;
+        int expected = wld ? (p->score > 0) - (p->score < 0) : p->score;
+        bool correct = (result.score == expected);
+        if (!correct) wrong++;
+        totalNodes += result.nodes;
+        totalMs += ms;
+        printf("%s,%d,%s,%lu,%.0f,%.0f\n", p->name, result.score,
+               correct ? "yes" : "no", (unsigned long) result.nodes, ms,
+               result.nodes * 1e3 / (ms > 0 ? ms : 1));
+    }
+    printf("total,,%s,%lu,%.0f,%.0f\n", wrong ? "no" : "yes",
+           (unsigned long) totalNodes, totalMs,
+           totalNodes * 1e3 / (totalMs > 0 ? totalMs : 1));
+    return wrong ? 1 : 0;
+}
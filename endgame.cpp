@@ -0,0 +1,440 @@
+#include "endgame.h"
+#include "eval.h"
+
+// Larger than any disc difference.
+#define ENDGAME_INF 100
+
+/*
+ * Order in which empty squares are tried, best first: corners, then the
+ * middle of the edges, the centre, and last the squares next to corners.
+ */
+static const int SQUARE_RANK[64] = {
+    0, 7, 1, 2, 2, 1, 7, 0,
+    7, 8, 6, 5, 5, 6, 8, 7,
+    1, 6, 3, 4, 4, 3, 6, 1,
+    2, 5, 4, 4, 4, 4, 5, 2,
+    2, 5, 4, 4, 4, 4, 5, 2,
+    1, 6, 3, 4, 4, 3, 6, 1,
+    7, 8, 6, 5, 5, 6, 8, 7,
+    0, 7, 1, 2, 2, 1, 7, 0
+};
+
+/*
+ * Which quadrant of the board (0 to 3) a square is in.
+ */
+static inline int quadrant(int sq) {
+    return ((sq >> 2) & 1) | ((sq >> 4) & 2);
+}
+
+/*
+ * Make a solver; it holds no position between calls to solve().
+ */
+Endgame::Endgame() {
+    nodes = 0;
+    clock = NULL;
+    stopped = false;
+    parity = 0;
+    next[64] = prev[64] = 64;
+    tt = NULL;
+    enhancedCutoffs = true;
+    stabilityCutoffs = true;
+}
+
+/*
+ * Destructor for the solver.
+ */
+Endgame::~Endgame() {
+}
+
+/*
+ * Solves the position with the given side to move to the end of the game.
+ * In win/loss/draw mode (wld) only the sign of the result is exact, which
+ * is much faster to prove. If a timer is given the solver gives up at its
+ * hard deadline and returns with solved set to false.
+ */
+EndgameResult Endgame::solve(Board *board, Side side, bool wld,
+                             TimeManager *timer) {
+    EndgameResult result;
+    uint64_t own = board->pieces(side);
+    uint64_t opp = board->pieces(opponent(side));
+    uint64_t empty = ~(own | opp);
+    int empties = popCount(empty);
+
+    nodes = 0;
+    clock = timer;
+    stopped = false;
+    buildEmptyList(empty);
+
+    int alpha = wld ? -1 : -ENDGAME_INF;
+    int beta = wld ? 1 : ENDGAME_INF;
+
+    result.move = -1;
+    uint64_t moves = legalMoveMask(own, opp);
+    if (moves == 0) {
+        // We have to pass; the position is solved from the other side.
+        nodes++;
+        result.score = legalMoveMask(opp, own)
+            ? -search(opp, own, -beta, -alpha, empties)
+            : finalDiff(own, opp);
+    }
+    else {
+        // Order the root moves fastest-first, like any other deep node.
+        int order[64];
+        int keys[64];
+        int numMoves = 0;
+        for (int sq = next[64]; sq != 64; sq = next[sq]) {
+            if (!((moves >> sq) & 1)) continue;
+            uint64_t flipped = flipMask(own, opp, sq);
+            uint64_t placed = (uint64_t) 1 << sq;
+            int key = popCount(legalMoveMask(opp & ~flipped,
+                                             own | flipped | placed));
+            int i = numMoves++;
+            for (; i > 0 && keys[i - 1] > key; i--) {
+                order[i] = order[i - 1];
+                keys[i] = keys[i - 1];
+            }
+            order[i] = sq;
+            keys[i] = key;
+        }
+
+        int best = -ENDGAME_INF;
+        for (int i = 0; i < numMoves && !stopped; i++) {
+            int sq = order[i];
+            uint64_t flipped = flipMask(own, opp, sq);
+            uint64_t newOwn = own | flipped | ((uint64_t) 1 << sq);
+            uint64_t newOpp = opp & ~flipped;
+
+            removeEmpty(sq);
+            int score;
+            if (i == 0) {
+                score = -search(newOpp, newOwn, -beta, -alpha, empties - 1);
+            }
+            else {
+                score = -search(newOpp, newOwn, -alpha - 1, -alpha,
+                                empties - 1);
+                if (score > alpha && score < beta)
+                    score = -search(newOpp, newOwn, -beta, -alpha,
+                                    empties - 1);
+            }
+            restoreEmpty(sq);
+
+            if (score > best && !stopped) {
+                best = score;
+                result.move = sq;
+                if (score > alpha) alpha = score;
+                if (alpha >= beta) break;
+            }
+        }
+        result.score = best;
+    }
+
+    if (wld) result.score = (result.score > 0) - (result.score < 0);
+    result.nodes = nodes;
+    result.solved = !stopped;
+    return result;
+}
+
+/*
+ * Fills the list of empty squares in SQUARE_RANK order and sets up the
+ * quadrant parity.
+ */
+void Endgame::buildEmptyList(uint64_t empty) {
+    int last = 64;
+    parity = 0;
+    for (int rank = 0; rank <= 8; rank++) {
+        for (int sq = 0; sq < 64; sq++) {
+            if (SQUARE_RANK[sq] != rank || !((empty >> sq) & 1)) continue;
+            next[last] = sq;
+            prev[sq] = last;
+            last = sq;
+            parity ^= 1 << quadrant(sq);
+        }
+    }
+    next[last] = 64;
+    prev[64] = last;
+}
+
+/*
+ * Takes a square out of the empty list when a move is played on it.
+ */
+void Endgame::removeEmpty(int sq) {
+    next[prev[sq]] = next[sq];
+    prev[next[sq]] = prev[sq];
+    parity ^= 1 << quadrant(sq);
+}
+
+/*
+ * Puts back the square most recently removed with removeEmpty().
+ */
+void Endgame::restoreEmpty(int sq) {
+    next[prev[sq]] = sq;
+    prev[next[sq]] = sq;
+    parity ^= 1 << quadrant(sq);
+}
+
+/*
+ * Alpha-beta search to the end of the game. Returns the final disc
+ * difference for the side owning "own", which is to move.
+ */
+int Endgame::search(uint64_t own, uint64_t opp, int alpha, int beta,
+                    int empties) {
+    // The last few empties are handled without the list or move masks.
+    if (empties <= 3) {
+        int sq1 = next[64];
+        int sq2 = next[sq1];
+        int sq3 = next[sq2];
+        if (empties == 3) {
+            // Play the square that is alone in its quadrant first.
+            if (quadrant(sq1) == quadrant(sq2)) {
+                int t = sq3; sq3 = sq2; sq2 = sq1; sq1 = t;
+            }
+            else if (quadrant(sq1) == quadrant(sq3)) {
+                int t = sq2; sq2 = sq1; sq1 = t;
+            }
+            return solve3(own, opp, alpha, beta, sq1, sq2, sq3);
+        }
+        if (empties == 2) return solve2(own, opp, alpha, beta, sq1, sq2);
+        if (empties == 1) return solve1(own, opp, sq1);
+        return finalDiff(own, opp);
+    }
+
+    nodes++;
+    if (clock && (nodes & (TIME_CHECK_NODES - 1)) == 0 && clock->outOfTime())
+        stopped = true;
+    if (stopped) return 0;
+
+    // The opponent keeps at least its stable discs, so the score is at
+    // most 64 minus twice as many. That can only be <= alpha if alpha is
+    // that high for all of its discs, which is cheap to check first.
+    if (stabilityCutoffs && empties >= STABILITY_EMPTIES
+        && alpha >= 64 - 2 * popCount(opp)) {
+        int bound = 64 - 2 * popCount(Eval::stableDiscs(opp, own));
+        if (bound <= alpha) return bound;
+    }
+
+    uint64_t moves = legalMoveMask(own, opp);
+    if (moves == 0) {
+        if (legalMoveMask(opp, own) == 0) return finalDiff(own, opp);
+        return -search(opp, own, -beta, -alpha, empties);
+    }
+
+    if (empties > FASTEST_FIRST_EMPTIES)
+        return searchFastestFirst(own, opp, moves, alpha, beta, empties);
+    return searchParity(own, opp, moves, alpha, beta, empties);
+}
+
+/*
+ * Tries the moves that leave the opponent the fewest replies first, after
+ * the best move stored for the position. This costs a move generation per
+ * child, which pays off only far from the end; so does the table, which
+ * is only used here.
+ *
+ * Every stored score is a bound on the final disc difference, so it holds
+ * whatever window it was searched with. With enhancedCutoffs, each child
+ * is looked up while the moves are ordered: one the opponent is known to
+ * score at most -beta in refutes this position before anything is
+ * searched.
+ */
+int Endgame::searchFastestFirst(uint64_t own, uint64_t opp, uint64_t moves,
+                                int alpha, int beta, int empties) {
+    uint64_t hash = tt ? positionKey(own, opp) : 0;
+    TTEntry entry;
+    int ttMove = -1;
+    if (tt && tt->probe(hash, &entry)) {
+        if (entry.bound == BOUND_EXACT
+            || (entry.bound == BOUND_LOWER && entry.score >= beta)
+            || (entry.bound == BOUND_UPPER && entry.score <= alpha))
+            return entry.score;
+        ttMove = entry.move;
+    }
+    int alphaOrig = alpha;
+    bool etc = tt && enhancedCutoffs && empties >= ETC_EMPTIES;
+
+    int order[64];
+    int keys[64];
+    int numMoves = 0;
+    for (int sq = next[64]; sq != 64; sq = next[sq]) {
+        if (!((moves >> sq) & 1)) continue;
+        uint64_t flipped = flipMask(own, opp, sq);
+        uint64_t newOwn = own | flipped | ((uint64_t) 1 << sq);
+        uint64_t newOpp = opp & ~flipped;
+        if (etc && tt->probe(positionKey(newOpp, newOwn), &entry)
+            && entry.bound != BOUND_LOWER && -entry.score >= beta) {
+            tt->store(hash, empties, BOUND_LOWER, -entry.score, sq);
+            return -entry.score;
+        }
+        int key = (sq == ttMove) ? -1 : popCount(legalMoveMask(newOpp,
+                                                               newOwn));
+        int i = numMoves++;
+        for (; i > 0 && keys[i - 1] > key; i--) {
+            order[i] = order[i - 1];
+            keys[i] = keys[i - 1];
+        }
+        order[i] = sq;
+        keys[i] = key;
+    }
+
+    int best = -ENDGAME_INF;
+    int bestMove = -1;
+    for (int i = 0; i < numMoves; i++) {
+        int sq = order[i];
+        uint64_t flipped = flipMask(own, opp, sq);
+        uint64_t newOwn = own | flipped | ((uint64_t) 1 << sq);
+        uint64_t newOpp = opp & ~flipped;
+
+        removeEmpty(sq);
+        int score;
+        if (i == 0) {
+            score = -search(newOpp, newOwn, -beta, -alpha, empties - 1);
+        }
+        else {
+            score = -search(newOpp, newOwn, -alpha - 1, -alpha, empties - 1);
+            if (score > alpha && score < beta)
+                score = -search(newOpp, newOwn, -beta, -alpha, empties - 1);
+        }
+        restoreEmpty(sq);
+
+        if (score > best) {
+            best = score;
+            bestMove = sq;
+            if (score > alpha) alpha = score;
+            if (alpha >= beta) break;
+        }
+    }
+
+    if (tt && !stopped) {
+        int bound = (best <= alphaOrig) ? BOUND_UPPER
+            : (best >= beta) ? BOUND_LOWER : BOUND_EXACT;
+        tt->store(hash, empties, bound, best, bestMove);
+    }
+    return best;
+}
+
+/*
+ * Tries moves in list order, squares in quadrants with an odd number of
+ * empties first: the last move in such a region tends to be ours.
+ */
+int Endgame::searchParity(uint64_t own, uint64_t opp, uint64_t moves,
+                          int alpha, int beta, int empties) {
+    int best = -ENDGAME_INF;
+    for (int odd = 1; odd >= 0; odd--) {
+        for (int sq = next[64]; sq != 64; sq = next[sq]) {
+            if (!((moves >> sq) & 1)) continue;
+            if (((parity >> quadrant(sq)) & 1) != odd) continue;
+
+            uint64_t flipped = flipMask(own, opp, sq);
+            removeEmpty(sq);
+            int score = -search(opp & ~flipped,
+                                own | flipped | ((uint64_t) 1 << sq),
+                                -beta, -alpha, empties - 1);
+            restoreEmpty(sq);
+
+            if (score > best) {
+                best = score;
+                if (score > alpha) alpha = score;
+                if (alpha >= beta) return best;
+            }
+        }
+    }
+    return best;
+}
+
+/*
+ * Three empties left. If neither side can move the game ends early.
+ */
+int Endgame::solve3(uint64_t own, uint64_t opp, int alpha, int beta,
+                    int sq1, int sq2, int sq3) {
+    nodes++;
+    int squares[3] = { sq1, sq2, sq3 };
+    int best = -ENDGAME_INF;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < 3; i++) {
+            int sq = squares[i];
+            uint64_t flipped = flipMask(own, opp, sq);
+            if (!flipped) continue;
+            int a = squares[i == 0 ? 1 : 0];
+            int b = squares[i == 2 ? 1 : 2];
+            int score = -solve2(opp & ~flipped,
+                                own | flipped | ((uint64_t) 1 << sq),
+                                -beta, -alpha, a, b);
+            if (score > best) {
+                best = score;
+                if (score > alpha) alpha = score;
+                if (alpha >= beta) break;
+            }
+        }
+        if (best > -ENDGAME_INF) return (pass == 0) ? best : -best;
+
+        // We have to pass: see whether the opponent can move instead.
+        uint64_t t = own; own = opp; opp = t;
+        int s = alpha; alpha = -beta; beta = -s;
+    }
+    // Neither side can move.
+    return finalDiff(own, opp);
+}
+
+/*
+ * Two empties left.
+ */
+int Endgame::solve2(uint64_t own, uint64_t opp, int alpha, int beta,
+                    int sq1, int sq2) {
+    nodes++;
+    for (int pass = 0; pass < 2; pass++) {
+        int best = -ENDGAME_INF;
+        uint64_t flipped = flipMask(own, opp, sq1);
+        if (flipped) {
+            best = -solve1(opp & ~flipped,
+                           own | flipped | ((uint64_t) 1 << sq1), sq2);
+            if (best >= beta) return (pass == 0) ? best : -best;
+        }
+        flipped = flipMask(own, opp, sq2);
+        if (flipped) {
+            int score = -solve1(opp & ~flipped,
+                                own | flipped | ((uint64_t) 1 << sq2), sq1);
+            if (score > best) best = score;
+        }
+        if (best > -ENDGAME_INF) return (pass == 0) ? best : -best;
+
+        // We have to pass: see whether the opponent can move instead.
+        uint64_t t = own; own = opp; opp = t;
+        int s = alpha; alpha = -beta; beta = -s;
+    }
+    // Neither side can move.
+    return finalDiff(own, opp);
+}
+
+/*
+ * One empty left: whoever can move there does, and the game is over.
+ */
+int Endgame::solve1(uint64_t own, uint64_t opp, int sq) {
+    nodes++;
+    int diff = popCount(own) - popCount(opp);
+    int flips = popCount(flipMask(own, opp, sq));
+    if (flips) return diff + 2 * flips + 1;
+    flips = popCount(flipMask(opp, own, sq));
+    if (flips) return diff - 2 * flips - 1;
+    return diff;
+}
+
+/*
+ * Final disc difference of a finished game for the side owning "own".
+ */
+int Endgame::finalDiff(uint64_t own, uint64_t opp) {
+    return popCount(own) - popCount(opp);
+}
+
+/*
+ * Table key of a position with the side owning "own" to move. The solver
+ * keeps no Zobrist hash, and one from scratch costs a lookup per disc, so
+ * the bitboards are mixed with the MurmurHash3 finalizer instead. Being
+ * unrelated to the Zobrist keys, these can share a table with the search.
+ */
+uint64_t Endgame::positionKey(uint64_t own, uint64_t opp) {
+    uint64_t h = own * 0x9e3779b97f4a7c15 ^ opp;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53;
+    h ^= h >> 33;
+    return h;
+}
@@ -0,0 +1,84 @@
+#ifndef __ENDGAME_H__
+#define __ENDGAME_H__
+
+#include <stdint.h>
+#include "common.h"
+#include "board.h"
+#include "timeman.h"
+#include "tt.h"
+
+// From this many empties down, moves are ordered by how few replies they
+// leave the opponent; closer to the end, plain parity order is faster.
+#define FASTEST_FIRST_EMPTIES 7
+
+// From this many empties up, every child is looked up in the table before
+// any of them is searched (enhanced transposition cutoffs). Only the
+// fastest-first nodes are stored, so below this there is nothing to find.
+#define ETC_EMPTIES 9
+
+// From this many empties up, the opponent's stable discs are counted for
+// an upper bound on the score.
+#define STABILITY_EMPTIES 6
+
+struct EndgameResult {
+    int move;       // Best square, or -1 to pass
+    int score;      // Final disc difference for the side to move, or in
+                    // win/loss/draw mode just its sign
+    uint64_t nodes;
+    bool solved;    // False if the clock ran out first
+};
+
+/*
+ * Exact endgame solver. Works directly on pairs of bitboards (the side to
+ * move and its opponent) and returns final disc differences, with special
+ * cases for the last three empties and a parity-ordered list of empty
+ * squares. Far from the end it also cuts off on stored results and on the
+ * opponent's stable discs.
+ */
+class Endgame {
+
+public:
+    Endgame();
+    ~Endgame();
+
+    EndgameResult solve(Board *board, Side side, bool wld,
+                        TimeManager *timer = NULL);
+
+    // Table to keep results in, from one solve to the next; may be NULL.
+    // Results are only stored far enough from the end to be worth it.
+    TranspositionTable *tt;
+    // Look up every child in the table before searching any of them.
+    bool enhancedCutoffs;
+    // Fail low when the opponent's stable discs keep the score <= alpha.
+    bool stabilityCutoffs;
+
+private:
+    uint64_t nodes;
+    TimeManager *clock;
+    bool stopped;
+
+    // Empty squares as a doubly linked list, best squares first. Index 64
+    // is the head; next[64] is the first empty square.
+    int next[65];
+    int prev[65];
+    int parity; // Bit q set if quadrant q has an odd number of empties
+
+    void buildEmptyList(uint64_t empty);
+    void removeEmpty(int sq);
+    void restoreEmpty(int sq);
+
+    int search(uint64_t own, uint64_t opp, int alpha, int beta, int empties);
+    int searchFastestFirst(uint64_t own, uint64_t opp, uint64_t moves,
+                           int alpha, int beta, int empties);
+    int searchParity(uint64_t own, uint64_t opp, uint64_t moves,
+                     int alpha, int beta, int empties);
+    int solve3(uint64_t own, uint64_t opp, int alpha, int beta,
+               int sq1, int sq2, int sq3);
+    int solve2(uint64_t own, uint64_t opp, int alpha, int beta,
+               int sq1, int sq2);
+    int solve1(uint64_t own, uint64_t opp, int sq);
+    int finalDiff(uint64_t own, uint64_t opp);
+    static uint64_t positionKey(uint64_t own, uint64_t opp);
+};
+
+#endif
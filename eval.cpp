@@ -0,0 +1,784 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "eval.h"
+
+#if defined(__x86_64__)
+#define HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// Most features one square can belong to.
+#define MAX_SQUARE_FEATURES 16
+
+/*
+ * Squares of each pattern type in one orientation, as x + 8*y. The other
+ * copies are the distinct images of these under the 8 board symmetries.
+ */
+static const int PATTERN_SIZE[NUM_PATTERN_TYPES] = {
+    8, 9, 10, 8, 8, 8, 8, 7, 6, 5, 4
+};
+static const int PATTERN_SQUARES[NUM_PATTERN_TYPES][MAX_PATTERN_SIZE] = {
+    {  0,  1,  2,  3,  4,  5,  6,  7 },
+    {  0,  1,  2,  8,  9, 10, 16, 17, 18 },
+    {  0,  1,  2,  3,  4,  8,  9, 10, 11, 12 },
+    {  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 16, 17, 18, 19, 20, 21, 22, 23 },
+    { 24, 25, 26, 27, 28, 29, 30, 31 },
+    {  0,  9, 18, 27, 36, 45, 54, 63 },
+    {  8, 17, 26, 35, 44, 53, 62 },
+    { 16, 25, 34, 43, 52, 61 },
+    { 24, 33, 42, 51, 60 },
+    { 32, 41, 50, 59 }
+};
+
+/*
+ * Pattern types that carry SQUARE_WEIGHTS in the default weights, in order
+ * of preference. Each square's weight goes to the first of these that
+ * covers it, and each of them covers the squares it gets exactly once, so
+ * the default evaluation equals Board::score(BLACK) - Board::score(WHITE).
+ */
+static const int DEFAULT_OWNERS[] = {
+    PATTERN_CORNER3X3, PATTERN_EDGE, PATTERN_LINE2, PATTERN_LINE3,
+    PATTERN_DIAG8
+};
+
+// Squares of every feature, and the type of each.
+static int featureType[NUM_FEATURES];
+static int featureSquares[NUM_FEATURES][MAX_PATTERN_SIZE];
+
+// For each square, the features it is in and the place value of its digit.
+static int squareFeatureCount[64];
+static int squareFeature[64][MAX_SQUARE_FEATURES];
+static uint16_t squarePower[64][MAX_SQUARE_FEATURES];
+
+// Weight tables, one per phase and pattern type, in one block.
+static int tableSize[NUM_PATTERN_TYPES];
+static short *weightTable[NUM_PHASES][NUM_PATTERN_TYPES];
+static short *weightData;
+static int weightCount;
+
+// Weights of the whole-board terms.
+static short termWeight[NUM_PHASES][NUM_TERMS];
+
+/*
+ * Default term weights per phase. Mobility matters most in the opening and
+ * midgame; stability grows in value as the board fills up.
+ */
+static const short DEFAULT_TERM_WEIGHTS[NUM_PHASES][NUM_TERMS] = {
+    { 3, 1, -1, 2 },
+    { 3, 1, -1, 2 },
+    { 2, 1, -1, 3 },
+    { 1, 0,  0, 3 }
+};
+
+// The 15 diagonals in each direction with at least one square, as masks.
+static uint64_t diagonals[15];
+static uint64_t antiDiagonals[15];
+
+/*
+ * Builds the feature and weight tables at startup and fills in the default
+ * weights.
+ */
+static struct EvalInit {
+    EvalInit() {
+        int numFeatures = 0;
+        for (int type = 0; type < NUM_PATTERN_TYPES; type++) {
+            uint64_t seen[8];
+            int numSeen = 0;
+            for (int symmetry = 0; symmetry < NUM_SYMMETRIES; symmetry++) {
+                int squares[MAX_PATTERN_SIZE];
+                uint64_t mask = 0;
+                for (int p = 0; p < PATTERN_SIZE[type]; p++) {
+                    squares[p] = transformSquare(PATTERN_SQUARES[type][p],
+                                                 symmetry);
+                    mask |= (uint64_t) 1 << squares[p];
+                }
+
+                // Symmetric patterns map onto themselves; keep one copy.
+                bool duplicate = false;
+                for (int i = 0; i < numSeen; i++)
+                    if (seen[i] == mask) duplicate = true;
+                if (duplicate) continue;
+                seen[numSeen++] = mask;
+
+                int f = numFeatures++;
+                featureType[f] = type;
+                int power = 1;
+                for (int p = 0; p < PATTERN_SIZE[type]; p++) {
+                    int sq = squares[p];
+                    featureSquares[f][p] = sq;
+                    int k = squareFeatureCount[sq]++;
+                    squareFeature[sq][k] = f;
+                    squarePower[sq][k] = power;
+                    power *= 3;
+                }
+            }
+        }
+        if (numFeatures != NUM_FEATURES) {
+            fprintf(stderr, "eval: expected %d features, found %d\n",
+                    NUM_FEATURES, numFeatures);
+            abort();
+        }
+
+        weightCount = 0;
+        for (int type = 0; type < NUM_PATTERN_TYPES; type++) {
+            tableSize[type] = 1;
+            for (int p = 0; p < PATTERN_SIZE[type]; p++) tableSize[type] *= 3;
+            weightCount += tableSize[type];
+        }
+        weightCount *= NUM_PHASES;
+
+        for (int sq = 0; sq < 64; sq++) {
+            int x = sq % 8;
+            int y = sq / 8;
+            diagonals[x - y + 7] |= (uint64_t) 1 << sq;
+            antiDiagonals[x + y] |= (uint64_t) 1 << sq;
+        }
+
+        // One spare entry: the AVX2 batch kernel gathers 32 bits at a time.
+        weightData = new short[weightCount + 1];
+        weightData[weightCount] = 0;
+        short *next = weightData;
+        for (int phase = 0; phase < NUM_PHASES; phase++) {
+            for (int type = 0; type < NUM_PATTERN_TYPES; type++) {
+                weightTable[phase][type] = next;
+                next += tableSize[type];
+            }
+        }
+        Eval::defaultWeights();
+    }
+} evalInit;
+
+/*
+ * Make an evaluator for the standard starting position.
+ */
+Eval::Eval() {
+    Board start;
+    setBoard(&start);
+}
+
+/*
+ * Destructor for the evaluator.
+ */
+Eval::~Eval() {
+}
+
+/*
+ * Computes every feature index of a position from scratch.
+ */
+void Eval::setBoard(Board *board) {
+    memset(index, 0, sizeof(index));
+    uint64_t black = board->pieces(BLACK);
+    uint64_t white = board->pieces(WHITE);
+    for (int sq = 0; sq < 64; sq++) {
+        int digit = ((black >> sq) & 1) ? 1 : ((white >> sq) & 1) ? 2 : 0;
+        for (int k = 0; k < squareFeatureCount[sq]; k++)
+            index[squareFeature[sq][k]] += digit * squarePower[sq][k];
+    }
+}
+
+/*
+ * Updates the indices for a move by the given side on square sq that flips
+ * the given discs.
+ */
+void Eval::update(int sq, uint64_t flipped, Side side) {
+    int digit = (side == BLACK) ? 1 : 2;
+    for (int k = 0; k < squareFeatureCount[sq]; k++)
+        index[squareFeature[sq][k]] += digit * squarePower[sq][k];
+
+    // A flip changes a digit from 2 to 1 or from 1 to 2.
+    for (; flipped; flipped &= flipped - 1) {
+        int f = firstSquare(flipped);
+        for (int k = 0; k < squareFeatureCount[f]; k++) {
+            if (side == BLACK) index[squareFeature[f][k]] -= squarePower[f][k];
+            else index[squareFeature[f][k]] += squarePower[f][k];
+        }
+    }
+}
+
+/*
+ * Takes back an update() for the same move.
+ */
+void Eval::undo(int sq, uint64_t flipped, Side side) {
+    int digit = (side == BLACK) ? 1 : 2;
+    for (int k = 0; k < squareFeatureCount[sq]; k++)
+        index[squareFeature[sq][k]] -= digit * squarePower[sq][k];
+
+    for (; flipped; flipped &= flipped - 1) {
+        int f = firstSquare(flipped);
+        for (int k = 0; k < squareFeatureCount[f]; k++) {
+            if (side == BLACK) index[squareFeature[f][k]] += squarePower[f][k];
+            else index[squareFeature[f][k]] -= squarePower[f][k];
+        }
+    }
+}
+
+/*
+ * Score of the position for the given side: the pattern score plus the
+ * weighted whole-board terms. The indices must match the board.
+ */
+int Eval::score(Board *board, Side side) {
+    return patternScore(board, side) + termScore(board, side);
+}
+
+/*
+ * Sum of the weights of every feature for the current phase.
+ */
+int Eval::patternScore(Board *board, Side side) {
+    short **tables = weightTable[phase(board)];
+    int score = 0;
+    for (int f = 0; f < NUM_FEATURES; f++)
+        score += tables[featureType[f]][index[f]];
+    return (side == BLACK) ? score : -score;
+}
+
+/*
+ * Weighted sum of the whole-board terms for the current phase.
+ */
+int Eval::termScore(Board *board, Side side) {
+    int values[NUM_TERMS];
+    terms(board, side, values);
+    short *weights = termWeight[phase(board)];
+    int score = 0;
+    for (int t = 0; t < NUM_TERMS; t++)
+        score += weights[t] * values[t];
+    return score;
+}
+
+/*
+ * Computes every EvalTerm for the given side, all from bitboards.
+ */
+void Eval::terms(Board *board, Side side, int *values) {
+    discTerms(board->pieces(side), board->pieces(opponent(side)), values);
+}
+
+/*
+ * Computes every EvalTerm for the side owning "own".
+ */
+void Eval::discTerms(uint64_t own, uint64_t opp, int *values) {
+    uint64_t empty = ~(own | opp);
+    uint64_t nextToEmpty = neighbours(empty);
+
+    values[TERM_MOBILITY] = popCount(legalMoveMask(own, opp))
+        - popCount(legalMoveMask(opp, own));
+    values[TERM_POTENTIAL_MOBILITY] = popCount(empty & neighbours(opp))
+        - popCount(empty & neighbours(own));
+    values[TERM_FRONTIER] = popCount(own & nextToEmpty)
+        - popCount(opp & nextToEmpty);
+    values[TERM_STABILITY] = popCount(stableDiscs(own, opp))
+        - popCount(stableDiscs(opp, own));
+}
+
+/*
+ * Returns discs of "own" that can never be flipped. A disc is stable if,
+ * along each of the 4 lines through it, the line is full, or it has the
+ * board edge or a stable disc of its own colour on one side. Starting from
+ * nothing, the corners qualify first and stability spreads from there.
+ */
+uint64_t Eval::stableDiscs(uint64_t own, uint64_t opp) {
+    uint64_t taken = own | opp;
+
+    // Full rows and columns, by folding each line onto itself.
+    uint64_t h = taken & (taken >> 1);
+    h &= h >> 2;
+    h &= h >> 4;
+    h = (h & 0x0101010101010101) * 0xff;
+    uint64_t v = taken;
+    v &= (v >> 8) | (v << 56);
+    v &= (v >> 16) | (v << 48);
+    v &= (v >> 32) | (v << 32);
+
+    uint64_t d = 0;
+    uint64_t a = 0;
+    for (int i = 0; i < 15; i++) {
+        if ((taken & diagonals[i]) == diagonals[i]) d |= diagonals[i];
+        if ((taken & antiDiagonals[i]) == antiDiagonals[i])
+            a |= antiDiagonals[i];
+    }
+
+    // Squares on the edge have the board edge on one side of every line
+    // except the one running along that edge.
+    const uint64_t border = 0xff818181818181ff;
+    h |= ~NOT_FILE_A | ~NOT_FILE_H;
+    v |= 0xff000000000000ff;
+    d |= border;
+    a |= border;
+
+    uint64_t stable = 0;
+    for (;;) {
+        uint64_t next = own
+            & (h | ((stable << 1) & NOT_FILE_A) | ((stable >> 1) & NOT_FILE_H))
+            & (v | (stable << 8) | (stable >> 8))
+            & (d | ((stable << 9) & NOT_FILE_A) | ((stable >> 9) & NOT_FILE_H))
+            & (a | ((stable << 7) & NOT_FILE_H) | ((stable >> 7) & NOT_FILE_A));
+        if (next == stable) return stable;
+        stable = next;
+    }
+}
+
+/*
+ * Game phase of a position, from 0 at the start to NUM_PHASES - 1 at the
+ * end, by number of discs on the board.
+ */
+int Eval::phase(Board *board) {
+    return discPhase(board->count(BLACK) + board->count(WHITE));
+}
+
+/*
+ * Game phase for the given number of discs on the board.
+ */
+int Eval::discPhase(int discs) {
+    int phase = (discs - 4) * NUM_PHASES / 61;
+    return (phase < NUM_PHASES) ? phase : NUM_PHASES - 1;
+}
+
+/*
+ * The pattern type of a feature, and so the table its index goes into.
+ */
+int Eval::featurePattern(int feature) {
+    return featureType[feature];
+}
+
+/*
+ * Number of squares in a pattern type; its tables have 3^size entries.
+ */
+int Eval::patternSize(int type) {
+    return PATTERN_SIZE[type];
+}
+
+/*
+ * The weight table of one pattern type in one phase.
+ */
+short *Eval::weights(int phase, int type) {
+    return weightTable[phase][type];
+}
+
+/*
+ * The weights of every EvalTerm in one phase.
+ */
+short *Eval::termWeights(int phase) {
+    return termWeight[phase];
+}
+
+/*
+ * Sets every phase to the default weights. The pattern tables reproduce
+ * Board::score(): each square's value from SQUARE_WEIGHTS is placed in the
+ * tables of one pattern type. The terms get DEFAULT_TERM_WEIGHTS.
+ */
+void Eval::defaultWeights() {
+    memcpy(termWeight, DEFAULT_TERM_WEIGHTS, sizeof(termWeight));
+
+    int owner[64];
+    for (int sq = 0; sq < 64; sq++) owner[sq] = -1;
+    int numOwners = sizeof(DEFAULT_OWNERS) / sizeof(DEFAULT_OWNERS[0]);
+    for (int i = 0; i < numOwners; i++) {
+        for (int f = 0; f < NUM_FEATURES; f++) {
+            if (featureType[f] != DEFAULT_OWNERS[i]) continue;
+            for (int p = 0; p < PATTERN_SIZE[featureType[f]]; p++)
+                if (owner[featureSquares[f][p]] < 0)
+                    owner[featureSquares[f][p]] = DEFAULT_OWNERS[i];
+        }
+    }
+
+    for (int type = 0; type < NUM_PATTERN_TYPES; type++) {
+        for (int index = 0; index < tableSize[type]; index++) {
+            int value = 0;
+            int rest = index;
+            for (int p = 0; p < PATTERN_SIZE[type]; p++, rest /= 3) {
+                int sq = PATTERN_SQUARES[type][p];
+                if (owner[sq] != type) continue;
+                if (rest % 3 == 1) value += SQUARE_WEIGHTS[sq];
+                if (rest % 3 == 2) value -= SQUARE_WEIGHTS[sq];
+            }
+            for (int phase = 0; phase < NUM_PHASES; phase++)
+                weightTable[phase][type][index] = value;
+        }
+    }
+}
+
+/*
+ * Replaces the weights with trained ones from a file written by
+ * saveWeights(). Returns false, leaving the weights alone, if the file is
+ * missing or doesn't match the current pattern set.
+ */
+bool Eval::loadWeights(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) return false;
+
+    uint32_t header[4];
+    bool ok = fread(header, sizeof(header), 1, file) == 1
+        && header[0] == WEIGHTS_MAGIC && header[1] == WEIGHTS_VERSION
+        && header[2] == NUM_PHASES && header[3] == NUM_PATTERN_TYPES;
+
+    short *data = new short[weightCount];
+    short terms[NUM_PHASES][NUM_TERMS];
+    ok = ok && fread(data, sizeof(short), weightCount, file)
+        == (size_t) weightCount;
+    ok = ok && fread(terms, sizeof(terms), 1, file) == 1;
+    if (ok) {
+        memcpy(weightData, data, weightCount * sizeof(short));
+        memcpy(termWeight, terms, sizeof(termWeight));
+    }
+
+    delete[] data;
+    fclose(file);
+    return ok;
+}
+
+/*
+ * Writes the current weights: a header of four 32-bit words (magic,
+ * version, phases, pattern types) followed by every table as 16-bit
+ * values, phase by phase and type by type, and then the term weights,
+ * NUM_TERMS per phase.
+ */
+bool Eval::saveWeights(const char *filename) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) return false;
+
+    uint32_t header[4] = {
+        WEIGHTS_MAGIC, WEIGHTS_VERSION, NUM_PHASES, NUM_PATTERN_TYPES
+    };
+    bool ok = fwrite(header, sizeof(header), 1, file) == 1
+        && fwrite(weightData, sizeof(short), weightCount, file)
+            == (size_t) weightCount
+        && fwrite(termWeight, sizeof(termWeight), 1, file) == 1;
+    return fclose(file) == 0 && ok;
+}
+
+/*
+ * Batch evaluation: score() for many independent positions given only as
+ * bitboards, with no Eval or Board to keep up to date. The positions are a
+ * structure of arrays, so that the AVX2 kernel can load the same field of
+ * several positions into one vector.
+ */
+
+/*
+ * One position at a time. The feature indices are built from the discs
+ * alone, skipping the empty squares.
+ */
+static void scoreBatchScalar(const uint64_t *black, const uint64_t *white,
+                             const Side *sides, int count, int *scores) {
+    for (int i = 0; i < count; i++) {
+        uint16_t index[NUM_FEATURES];
+        memset(index, 0, sizeof(index));
+        for (uint64_t b = black[i]; b; b &= b - 1) {
+            int sq = firstSquare(b);
+            for (int k = 0; k < squareFeatureCount[sq]; k++)
+                index[squareFeature[sq][k]] += squarePower[sq][k];
+        }
+        for (uint64_t w = white[i]; w; w &= w - 1) {
+            int sq = firstSquare(w);
+            for (int k = 0; k < squareFeatureCount[sq]; k++)
+                index[squareFeature[sq][k]] += 2 * squarePower[sq][k];
+        }
+
+        int phase = Eval::discPhase(popCount(black[i] | white[i]));
+        short **tables = weightTable[phase];
+        int score = 0;
+        for (int f = 0; f < NUM_FEATURES; f++)
+            score += tables[featureType[f]][index[f]];
+        if (sides[i] == WHITE) score = -score;
+
+        int values[NUM_TERMS];
+        if (sides[i] == BLACK) Eval::discTerms(black[i], white[i], values);
+        else Eval::discTerms(white[i], black[i], values);
+        for (int t = 0; t < NUM_TERMS; t++)
+            score += termWeight[phase][t] * values[t];
+        scores[i] = score;
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+// Positions per block of the AVX2 kernel, one per 32-bit lane.
+#define BATCH_BLOCK 8
+
+AVX2_TARGET static inline __m256i shiftLeft(__m256i x, int s) {
+    return _mm256_sll_epi64(x, _mm_cvtsi32_si128(s));
+}
+
+AVX2_TARGET static inline __m256i shiftRight(__m256i x, int s) {
+    return _mm256_srl_epi64(x, _mm_cvtsi32_si128(s));
+}
+
+/*
+ * popCount() of each 64-bit lane: a nibble lookup with a byte shuffle,
+ * summed per lane.
+ */
+AVX2_TARGET static inline __m256i popCount4(__m256i v) {
+    const __m256i table = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(v, nibble));
+    __m256i high = _mm256_shuffle_epi8(table,
+        _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+    return _mm256_sad_epu8(_mm256_add_epi8(low, high),
+                           _mm256_setzero_si256());
+}
+
+/*
+ * movesLeft() and movesRight() from bitboard.h, on four boards at once.
+ */
+AVX2_TARGET static inline __m256i movesLeft4(__m256i own, __m256i pro,
+                                             __m256i empty, int s) {
+    __m256i x = _mm256_and_si256(shiftLeft(own, s), pro);
+    x = _mm256_or_si256(x, _mm256_and_si256(pro, shiftLeft(x, s)));
+    pro = _mm256_and_si256(pro, shiftLeft(pro, s));
+    x = _mm256_or_si256(x, _mm256_and_si256(pro, shiftLeft(x, 2 * s)));
+    pro = _mm256_and_si256(pro, shiftLeft(pro, 2 * s));
+    x = _mm256_or_si256(x, _mm256_and_si256(pro, shiftLeft(x, 4 * s)));
+    return _mm256_and_si256(shiftLeft(x, s), empty);
+}
+
+AVX2_TARGET static inline __m256i movesRight4(__m256i own, __m256i pro,
+                                              __m256i empty, int s) {
+    __m256i x = _mm256_and_si256(shiftRight(own, s), pro);
+    x = _mm256_or_si256(x, _mm256_and_si256(pro, shiftRight(x, s)));
+    pro = _mm256_and_si256(pro, shiftRight(pro, s));
+    x = _mm256_or_si256(x, _mm256_and_si256(pro, shiftRight(x, 2 * s)));
+    pro = _mm256_and_si256(pro, shiftRight(pro, 2 * s));
+    x = _mm256_or_si256(x, _mm256_and_si256(pro, shiftRight(x, 4 * s)));
+    return _mm256_and_si256(shiftRight(x, s), empty);
+}
+
+/*
+ * legalMoveMaskScalar() on four boards at once.
+ */
+AVX2_TARGET static inline __m256i legalMoves4(__m256i own, __m256i opp) {
+    __m256i empty = _mm256_xor_si256(_mm256_or_si256(own, opp),
+                                     _mm256_set1_epi64x(-1));
+    __m256i inner = _mm256_and_si256(opp, _mm256_set1_epi64x(INNER_FILES));
+    __m256i moves = _mm256_or_si256(movesLeft4(own, inner, empty, 1),
+                                    movesRight4(own, inner, empty, 1));
+    moves = _mm256_or_si256(moves, movesLeft4(own, opp, empty, 8));
+    moves = _mm256_or_si256(moves, movesRight4(own, opp, empty, 8));
+    moves = _mm256_or_si256(moves, movesLeft4(own, inner, empty, 7));
+    moves = _mm256_or_si256(moves, movesRight4(own, inner, empty, 7));
+    moves = _mm256_or_si256(moves, movesLeft4(own, inner, empty, 9));
+    return _mm256_or_si256(moves, movesRight4(own, inner, empty, 9));
+}
+
+/*
+ * neighbours() on four boards at once.
+ */
+AVX2_TARGET static inline __m256i neighbours4(__m256i b) {
+    __m256i east = _mm256_and_si256(_mm256_slli_epi64(b, 1),
+                                    _mm256_set1_epi64x(NOT_FILE_A));
+    __m256i west = _mm256_and_si256(_mm256_srli_epi64(b, 1),
+                                    _mm256_set1_epi64x(NOT_FILE_H));
+    __m256i row = _mm256_or_si256(b, _mm256_or_si256(east, west));
+    __m256i all = _mm256_or_si256(row, _mm256_or_si256(
+        _mm256_slli_epi64(row, 8), _mm256_srli_epi64(row, 8)));
+    return _mm256_andnot_si256(b, all);
+}
+
+/*
+ * Eval::stableDiscs() on four boards at once. The lanes iterate together
+ * until none of them changes.
+ */
+AVX2_TARGET static inline __m256i stableDiscs4(__m256i own, __m256i opp) {
+    __m256i taken = _mm256_or_si256(own, opp);
+
+    // Full rows: fold each row onto its first square, then spread it back.
+    __m256i h = _mm256_and_si256(taken, _mm256_srli_epi64(taken, 1));
+    h = _mm256_and_si256(h, _mm256_srli_epi64(h, 2));
+    h = _mm256_and_si256(h, _mm256_srli_epi64(h, 4));
+    h = _mm256_and_si256(h, _mm256_set1_epi64x(0x0101010101010101));
+    h = _mm256_or_si256(h, _mm256_slli_epi64(h, 1));
+    h = _mm256_or_si256(h, _mm256_slli_epi64(h, 2));
+    h = _mm256_or_si256(h, _mm256_slli_epi64(h, 4));
+    __m256i v = taken;
+    for (int s = 8; s < 64; s *= 2) {
+        v = _mm256_and_si256(v, _mm256_or_si256(shiftRight(v, s),
+                                                shiftLeft(v, 64 - s)));
+    }
+
+    __m256i d = _mm256_setzero_si256();
+    __m256i a = _mm256_setzero_si256();
+    for (int i = 0; i < 15; i++) {
+        __m256i diagonal = _mm256_set1_epi64x(diagonals[i]);
+        __m256i anti = _mm256_set1_epi64x(antiDiagonals[i]);
+        d = _mm256_or_si256(d, _mm256_and_si256(diagonal, _mm256_cmpeq_epi64(
+            _mm256_and_si256(taken, diagonal), diagonal)));
+        a = _mm256_or_si256(a, _mm256_and_si256(anti, _mm256_cmpeq_epi64(
+            _mm256_and_si256(taken, anti), anti)));
+    }
+
+    const __m256i border = _mm256_set1_epi64x(0xff818181818181ff);
+    const __m256i fileA = _mm256_set1_epi64x(NOT_FILE_A);
+    const __m256i fileH = _mm256_set1_epi64x(NOT_FILE_H);
+    h = _mm256_or_si256(h, _mm256_set1_epi64x(~NOT_FILE_A | ~NOT_FILE_H));
+    v = _mm256_or_si256(v, _mm256_set1_epi64x(0xff000000000000ff));
+    d = _mm256_or_si256(d, border);
+    a = _mm256_or_si256(a, border);
+
+    __m256i stable = _mm256_setzero_si256();
+    for (;;) {
+        __m256i next = _mm256_and_si256(own, _mm256_or_si256(h,
+            _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi64(stable, 1),
+                                             fileA),
+                            _mm256_and_si256(_mm256_srli_epi64(stable, 1),
+                                             fileH))));
+        next = _mm256_and_si256(next, _mm256_or_si256(v,
+            _mm256_or_si256(_mm256_slli_epi64(stable, 8),
+                            _mm256_srli_epi64(stable, 8))));
+        next = _mm256_and_si256(next, _mm256_or_si256(d,
+            _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi64(stable, 9),
+                                             fileA),
+                            _mm256_and_si256(_mm256_srli_epi64(stable, 9),
+                                             fileH))));
+        next = _mm256_and_si256(next, _mm256_or_si256(a,
+            _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi64(stable, 7),
+                                             fileH),
+                            _mm256_and_si256(_mm256_srli_epi64(stable, 7),
+                                             fileA))));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(next, stable)) == -1)
+            return stable;
+        stable = next;
+    }
+}
+
+/*
+ * The EvalTerm values of four positions, one per 64-bit lane, for the side
+ * owning "own".
+ */
+AVX2_TARGET static inline void discTerms4(__m256i own, __m256i opp,
+                                          __m256i *values) {
+    __m256i empty = _mm256_xor_si256(_mm256_or_si256(own, opp),
+                                     _mm256_set1_epi64x(-1));
+    __m256i nextToEmpty = neighbours4(empty);
+    values[TERM_MOBILITY] = _mm256_sub_epi64(
+        popCount4(legalMoves4(own, opp)), popCount4(legalMoves4(opp, own)));
+    values[TERM_POTENTIAL_MOBILITY] = _mm256_sub_epi64(
+        popCount4(_mm256_and_si256(empty, neighbours4(opp))),
+        popCount4(_mm256_and_si256(empty, neighbours4(own))));
+    values[TERM_FRONTIER] = _mm256_sub_epi64(
+        popCount4(_mm256_and_si256(own, nextToEmpty)),
+        popCount4(_mm256_and_si256(opp, nextToEmpty)));
+    values[TERM_STABILITY] = _mm256_sub_epi64(
+        popCount4(stableDiscs4(own, opp)), popCount4(stableDiscs4(opp, own)));
+}
+
+/*
+ * Splits the bitboards of eight positions into one vector of their low
+ * halves (squares 0 to 31) and one of their high halves.
+ */
+AVX2_TARGET static inline void splitHalves(const uint64_t *b, __m256i *low,
+                                           __m256i *high) {
+    const __m256i order = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    __m256i first = _mm256_permutevar8x32_epi32(
+        _mm256_loadu_si256((const __m256i *) b), order);
+    __m256i second = _mm256_permutevar8x32_epi32(
+        _mm256_loadu_si256((const __m256i *) (b + 4)), order);
+    *low = _mm256_permute2x128_si256(first, second, 0x20);
+    *high = _mm256_permute2x128_si256(first, second, 0x31);
+}
+
+/*
+ * Eight positions at a time, one per 32-bit lane. Each square's digit is
+ * worked out once for all eight; every feature index is then a Horner sum
+ * of its squares' digits, and its weights are fetched with one gather from
+ * the block of all tables. The terms take four positions per vector.
+ * Leftover positions go to the scalar kernel.
+ */
+AVX2_TARGET static void scoreBatchAVX2(const uint64_t *black,
+                                       const uint64_t *white,
+                                       const Side *sides, int count,
+                                       int *scores) {
+    const __m256i one = _mm256_set1_epi32(1);
+    int blocks = count / BATCH_BLOCK * BATCH_BLOCK;
+    for (int i = 0; i < blocks; i += BATCH_BLOCK) {
+        __m256i digits[64];
+        __m256i blackHalf[2], whiteHalf[2];
+        splitHalves(black + i, &blackHalf[0], &blackHalf[1]);
+        splitHalves(white + i, &whiteHalf[0], &whiteHalf[1]);
+        for (int half = 0; half < 2; half++) {
+            __m256i b = blackHalf[half], w = whiteHalf[half];
+            for (int sq = 32 * half; sq < 32 * half + 32; sq++) {
+                digits[sq] = _mm256_add_epi32(_mm256_and_si256(b, one),
+                    _mm256_slli_epi32(_mm256_and_si256(w, one), 1));
+                b = _mm256_srli_epi32(b, 1);
+                w = _mm256_srli_epi32(w, 1);
+            }
+        }
+
+        int phases[BATCH_BLOCK];
+        int32_t starts[BATCH_BLOCK], signs[BATCH_BLOCK];
+        for (int k = 0; k < BATCH_BLOCK; k++) {
+            phases[k] = Eval::discPhase(popCount(black[i + k]
+                                                 | white[i + k]));
+            starts[k] = weightTable[phases[k]][0] - weightData;
+            signs[k] = (sides[i + k] == WHITE) ? -1 : 0;
+        }
+        __m256i start = _mm256_loadu_si256((const __m256i *) starts);
+
+        __m256i sum = _mm256_setzero_si256();
+        for (int f = 0; f < NUM_FEATURES; f++) {
+            int type = featureType[f];
+            const int *squares = featureSquares[f];
+            __m256i index = digits[squares[PATTERN_SIZE[type] - 1]];
+            for (int p = PATTERN_SIZE[type] - 2; p >= 0; p--) {
+                index = _mm256_add_epi32(index,
+                                         _mm256_add_epi32(index, index));
+                index = _mm256_add_epi32(index, digits[squares[p]]);
+            }
+            __m256i offset = _mm256_add_epi32(_mm256_add_epi32(start, index),
+                _mm256_set1_epi32(weightTable[0][type] - weightData));
+            __m256i w = _mm256_i32gather_epi32((const int *) weightData,
+                                               offset, 2);
+            sum = _mm256_add_epi32(sum,
+                _mm256_srai_epi32(_mm256_slli_epi32(w, 16), 16));
+        }
+        __m256i sign = _mm256_loadu_si256((const __m256i *) signs);
+        sum = _mm256_sub_epi32(_mm256_xor_si256(sum, sign), sign);
+        int32_t pattern[BATCH_BLOCK];
+        _mm256_storeu_si256((__m256i *) pattern, sum);
+
+        for (int k = 0; k < BATCH_BLOCK; k += 4) {
+            __m256i b = _mm256_loadu_si256((const __m256i *) (black + i + k));
+            __m256i w = _mm256_loadu_si256((const __m256i *) (white + i + k));
+            __m256i whiteToMove = _mm256_set_epi64x(signs[k + 3],
+                signs[k + 2], signs[k + 1], signs[k]);
+            __m256i own = _mm256_blendv_epi8(b, w, whiteToMove);
+            __m256i opp = _mm256_blendv_epi8(w, b, whiteToMove);
+            __m256i values[NUM_TERMS];
+            discTerms4(own, opp, values);
+
+            int64_t lanes[NUM_TERMS][4];
+            for (int t = 0; t < NUM_TERMS; t++)
+                _mm256_storeu_si256((__m256i *) lanes[t], values[t]);
+            for (int j = 0; j < 4; j++) {
+                int score = pattern[k + j];
+                short *weights = termWeight[phases[k + j]];
+                for (int t = 0; t < NUM_TERMS; t++)
+                    score += weights[t] * (int) lanes[t][j];
+                scores[i + k + j] = score;
+            }
+        }
+    }
+    scoreBatchScalar(black + blocks, white + blocks, sides + blocks,
+                     count - blocks, scores + blocks);
+}
+
+#endif
+
+/*
+ * Scores count positions, position i being black[i] and white[i] with
+ * sides[i] to move, into scores[i]; each is what score() would give. Uses
+ * the AVX2 kernel when the move generation kernels are AVX2 as well (see
+ * setSimdLevel()), and the scalar one otherwise.
+ */
+void Eval::scoreBatch(const uint64_t *black, const uint64_t *white,
+                      const Side *sides, int count, int *scores) {
+#ifdef HAVE_X86_SIMD
+    if (simdLevel() == SIMD_AVX2) {
+        scoreBatchAVX2(black, white, sides, count, scores);
+        return;
+    }
+#endif
+    scoreBatchScalar(black, white, sides, count, scores);
+}
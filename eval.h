@@ -0,0 +1,87 @@
+#ifndef __EVAL_H__
+#define __EVAL_H__
+
+#include <stdint.h>
+#include "common.h"
+#include "board.h"
+
+// Weight file read at startup if it exists, and its header.
+#define WEIGHTS_FILE "weights.bin"
+#define WEIGHTS_MAGIC 0x5748544f // "OTHW" read as a little-endian word
+#define WEIGHTS_VERSION 2
+
+// The game is split into this many phases by disc count, each with its own
+// weights.
+#define NUM_PHASES 4
+
+// Kinds of pattern. Every kind has one weight table per phase, shared by
+// all of its symmetric copies on the board.
+enum PatternType {
+    PATTERN_EDGE,       // A full edge
+    PATTERN_CORNER3X3,  // 3x3 block in a corner
+    PATTERN_CORNER2X5,  // 2x5 block along an edge from a corner
+    PATTERN_LINE2,      // Second row or column in from an edge
+    PATTERN_LINE3,
+    PATTERN_LINE4,
+    PATTERN_DIAG8,      // Diagonals of length 8 down to 4
+    PATTERN_DIAG7,
+    PATTERN_DIAG6,
+    PATTERN_DIAG5,
+    PATTERN_DIAG4,
+    NUM_PATTERN_TYPES
+};
+
+// Whole-board terms added to the pattern score, each the side to move's
+// count minus the opponent's, with one weight per phase.
+enum EvalTerm {
+    TERM_MOBILITY,           // Legal moves
+    TERM_POTENTIAL_MOBILITY, // Empty squares next to opponent discs
+    TERM_FRONTIER,           // Own discs next to an empty square
+    TERM_STABILITY,          // Discs that can never be flipped
+    NUM_TERMS
+};
+
+// Copies of all pattern types on the board.
+#define NUM_FEATURES 46
+// Most squares in one pattern.
+#define MAX_PATTERN_SIZE 10
+
+/*
+ * Table-driven pattern evaluation. Each feature (one copy of a pattern on
+ * the board) is a base-3 number with one digit per square: 0 for empty, 1
+ * for black and 2 for white. An Eval keeps these indices for one position
+ * and updates them with each move and flip; the weight tables they index
+ * are shared by every Eval.
+ */
+class Eval {
+
+public:
+    Eval();
+    ~Eval();
+
+    void setBoard(Board *board);
+    void update(int sq, uint64_t flipped, Side side);
+    void undo(int sq, uint64_t flipped, Side side);
+    int score(Board *board, Side side);
+    int patternScore(Board *board, Side side);
+    static void scoreBatch(const uint64_t *black, const uint64_t *white,
+                           const Side *sides, int count, int *scores);
+    static int termScore(Board *board, Side side);
+    static void terms(Board *board, Side side, int *values);
+    static void discTerms(uint64_t own, uint64_t opp, int *values);
+    static uint64_t stableDiscs(uint64_t own, uint64_t opp);
+
+    static int phase(Board *board);
+    static int discPhase(int discs);
+    static int patternSize(int type);
+    static int featurePattern(int feature);
+    static short *weights(int phase, int type);
+    static short *termWeights(int phase);
+    static void defaultWeights();
+    static bool loadWeights(const char *filename);
+    static bool saveWeights(const char *filename);
+
+    uint16_t index[NUM_FEATURES];
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "common.h"
+#include "board.h"
+#include "search.h"
+#include "probcut.h"
+#include "record.h"
+
+// Plies of random moves at the start of each game, from MIN_RANDOM_PLIES
+// up to MAX_RANDOM_PLIES, so that games spread out over many openings.
+#define MIN_RANDOM_PLIES 6
+#define MAX_RANDOM_PLIES 12
+
+// Most positions one game can have: one per move, passes aside.
+#define MAX_GAME_POSITIONS 64
+
+/*
+ * Picks one of the given moves at random.
+ */
+static int randomMove(uint64_t moves) {
+    for (int k = rand() % popCount(moves); k > 0; k--)
+        moves &= moves - 1;
+    return firstSquare(moves);
+}
+
+/*
+ * Generates training positions for the tune tool by self-play. Each game
+ * opens with a few random moves and is then played out by the search at
+ * the given depth. Every position where the side to move has a move is
+ * written as a record with the move played, the search result if there
+ * was one, and the final disc difference for the side to move. Once the
+ * search solves the endgame, both sides play perfectly, so positions from
+ * there on carry their exact score and are flagged as such.
+ *
+ * Records are appended to the position file, so runs can be repeated to
+ * grow it.
+ *
+ * usage: gendata [games] [depth] [file] [seed]
+ */
+int main(int argc, char *argv[]) {
+    int games = (argc > 1) ? atoi(argv[1]) : 1000;
+    int depth = (argc > 2) ? atoi(argv[2]) : 6;
+    const char *filename = (argc > 3) ? argv[3] : "train.bin";
+    srand((argc > 4) ? atoi(argv[4]) : time(NULL));
+
+    Eval::loadWeights(WEIGHTS_FILE);
+    ProbCut::load(PROBCUT_FILE);
+    TranspositionTable tt(DEFAULT_TT_MB);
+    Search search;
+    search.tt = &tt;
+
+    PositionWriter writer;
+    if (!writer.open(filename)) {
+        fprintf(stderr, "could not open %s\n", filename);
+        return 1;
+    }
+
+    long total = 0;
+    PositionRecord positions[MAX_GAME_POSITIONS];
+    for (int game = 0; game < games; game++) {
+        Board board;
+        Side side = BLACK;
+        int randomPlies = MIN_RANDOM_PLIES
+            + rand() % (MAX_RANDOM_PLIES - MIN_RANDOM_PLIES + 1);
+        int count = 0;
+        tt.clear();
+        for (int ply = 0; !board.isDone(); ply++) {
+            uint64_t moves = board.legalMoves(side);
+            if (moves) {
+                int empties = 64 - board.count(BLACK) - board.count(WHITE);
+                PositionRecord *p = &positions[count];
+                recordFromBoard(&board, side, p);
+                p->flags |= RECORD_MOVE | RECORD_SCORE
+                    | (count == 0 ? RECORD_GAME_START : 0);
+                if (ply >= randomPlies && empties <= search.exactEmpties)
+                    p->flags |= RECORD_EXACT;
+                count++;
+
+                int sq;
+                if (ply < randomPlies) {
+                    sq = randomMove(moves);
+                } else {
+                    SearchResult result = search.run(&board, side, depth);
+                    sq = result.move;
+                    p->flags |= RECORD_VALUE;
+                    p->value = result.score;
+                    p->depth = result.depth;
+                }
+                p->move = sq;
+                board.makeMove(sq, side);
+            }
+            side = opponent(side);
+        }
+
+        int diff = board.count(BLACK) - board.count(WHITE);
+        for (int i = 0; i < count; i++) {
+            positions[i].score = (positions[i].flags & RECORD_WHITE_TO_MOVE)
+                ? -diff : diff;
+            if (!writer.write(&positions[i])) {
+                fprintf(stderr, "could not write %s\n", filename);
+                return 1;
+            }
+        }
+        total += count;
+        if ((game + 1) % 100 == 0)
+            fprintf(stderr, "%d of %d games, %ld positions\n", game + 1,
+                    games, total);
+    }
+
+    if (!writer.close()) {
+        fprintf(stderr, "could not write %s\n", filename);
+        return 1;
+    }
+    printf("%ld positions from %d games written to %s\n", total, games,
+           filename);
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include "common.h"
+#include "board.h"
+#include "search.h"
+#include "book.h"
+#include "record.h"
+
+/*
+ * Reads an existing book file into the map, if there is one.
+ */
+static void readBook(const char *filename, map<uint64_t, BookEntry> *book) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) return;
+    BookHeader header;
+    if (fread(&header, sizeof(header), 1, file) == 1
+        && header.magic == BOOK_MAGIC && header.version == BOOK_VERSION) {
+        BookEntry entry;
+        for (uint32_t i = 0; i < header.count; i++) {
+            if (fread(&entry, sizeof(entry), 1, file) != 1) break;
+            (*book)[entry.key] = entry;
+        }
+    }
+    fclose(file);
+}
+
+/*
+ * Writes the book out sorted by key, which is the order the map keeps.
+ */
+static bool writeBook(const char *filename, map<uint64_t, BookEntry> *book) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) return false;
+    BookHeader header = { BOOK_MAGIC, BOOK_VERSION, (uint32_t) book->size(),
+                          0 };
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    map<uint64_t, BookEntry>::iterator it;
+    for (it = book->begin(); ok && it != book->end(); ++it)
+        ok = fwrite(&it->second, sizeof(BookEntry), 1, file) == 1;
+    return fclose(file) == 0 && ok;
+}
+
+/*
+ * Searches a position and adds it to the book if it isn't there yet.
+ * Returns its canonical key, and the symmetry that gives it in sym.
+ */
+static uint64_t addPosition(map<uint64_t, BookEntry> *book, Search *search,
+                            Board *board, Side side, int depth, int *sym) {
+    uint64_t key = OpeningBook::canonicalKey(board->pieces(side),
+        board->pieces(opponent(side)), sym);
+    if (book->find(key) == book->end()) {
+        SearchResult result = search->run(board, side, depth);
+        BookEntry entry;
+        entry.key = key;
+        entry.score = result.score;
+        entry.move = transformSquare(result.move, *sym);
+        entry.depth = result.depth;
+        entry.reserved = 0;
+        (*book)[key] = entry;
+    }
+    return key;
+}
+
+/*
+ * Grows an opening book by self-play. Each game follows the book's own
+ * moves except at one random ply, where it plays a random legal move, so
+ * the book spreads out around its main lines. Every position reached in
+ * the first "plies" plies that isn't in the book yet is searched to the
+ * given depth and added. An existing book file is extended, not replaced.
+ *
+ * Position files given after the book file, such as games converted from
+ * move notation, add every position of theirs within the first "plies"
+ * plies before the self-play games start.
+ *
+ * usage: makebook [games] [depth] [plies] [file] [positions...]
+ */
+int main(int argc, char *argv[]) {
+    int games = (argc > 1) ? atoi(argv[1]) : 100;
+    int depth = (argc > 2) ? atoi(argv[2]) : 10;
+    int plies = (argc > 3) ? atoi(argv[3]) : 16;
+    const char *filename = (argc > 4) ? argv[4] : BOOK_FILE;
+    if (games < 1 || depth < 1 || plies < 1) {
+        fprintf(stderr, "usage: %s [games] [depth] [plies] [file]"
+                " [positions...]\n", argv[0]);
+        return 1;
+    }
+
+    Eval::loadWeights(WEIGHTS_FILE);
+    ProbCut::load(PROBCUT_FILE);
+    map<uint64_t, BookEntry> book;
+    readBook(filename, &book);
+    size_t startSize = book.size();
+
+    TranspositionTable tt(DEFAULT_TT_MB);
+    Search search;
+    search.tt = &tt;
+    srand(1 + startSize);
+
+    for (int i = 5; i < argc; i++) {
+        PositionFile positions;
+        if (!positions.open(argv[i])) {
+            fprintf(stderr, "could not read %s\n", argv[i]);
+            return 1;
+        }
+        const PositionRecord *records = positions.records();
+        for (size_t n = 0; n < positions.size(); n++) {
+            Board board;
+            Side side = recordToBoard(&records[n], &board);
+            if (board.count(BLACK) + board.count(WHITE) - 4 >= plies
+                || !board.legalMoves(side))
+                continue;
+            int sym;
+            addPosition(&book, &search, &board, side, depth, &sym);
+        }
+        fprintf(stderr, "%s: %lu positions\n", argv[i],
+                (unsigned long) book.size());
+    }
+
+    for (int game = 0; game < games; game++) {
+        Board board;
+        Side side = BLACK;
+        int deviation = rand() % plies;
+        for (int ply = 0; ply < plies; ply++) {
+            uint64_t moves = board.legalMoves(side);
+            if (moves == 0) {
+                if (board.legalMoves(opponent(side)) == 0) break;
+                side = opponent(side);
+                moves = board.legalMoves(side);
+            }
+
+            int sym;
+            uint64_t key = addPosition(&book, &search, &board, side, depth,
+                                       &sym);
+
+            int sq;
+            if (ply == deviation) {
+                for (int k = rand() % popCount(moves); k > 0; k--)
+                    moves &= moves - 1;
+                sq = firstSquare(moves);
+            } else {
+                sq = inverseSquare(book[key].move, sym);
+            }
+            board.makeMove(sq, side);
+            side = opponent(side);
+        }
+        fprintf(stderr, "game %d: %lu positions\n", game + 1,
+                (unsigned long) book.size());
+    }
+
+    if (!writeBook(filename, &book)) {
+        fprintf(stderr, "could not write %s\n", filename);
+        return 1;
+    }
+    printf("%lu positions added, %lu in %s\n",
+           (unsigned long) (book.size() - startSize),
+           (unsigned long) book.size(), filename);
+    return 0;
+}
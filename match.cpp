@@ -0,0 +1,419 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <vector>
+#include <pthread.h>
+#include "common.h"
+#include "board.h"
+#include "player.h"
+#include "record.h"
+
+// Random opening moves played before each pair of games.
+#define DEFAULT_RANDOM_PLIES 8
+
+// Hash table size per player unless configured otherwise.
+#define MATCH_TT_MB 16
+
+// Games between progress reports.
+#define REPORT_INTERVAL 20
+
+/*
+ * How one side of the match plays. gameTime is the clock for the whole
+ * game in milliseconds, or 0 to search to a fixed depth instead.
+ */
+struct EngineConfig {
+    int depth;
+    int gameTime;
+    int hashMB;
+    int threads;
+    int exactEmpties;
+    int wldEmpties;
+    double probCut;
+    bool ponder;
+    bool discCount;
+    const char *bookFile;
+};
+
+/*
+ * One opening position and the side to move in it.
+ */
+struct Opening {
+    Board board;
+    Side side;
+};
+
+/*
+ * State shared by the game-playing threads: the next game to play and the
+ * results so far, counted from the first engine's point of view.
+ */
+struct Match {
+    EngineConfig engines[2];
+    vector<Opening> openings;
+    int randomPlies;
+    int maxGames;
+    bool sprt;
+    double elo0, elo1, alpha, beta;
+
+    pthread_mutex_t lock;
+    int nextGame;
+    int wins, draws, losses;
+    bool stopped;
+};
+
+/*
+ * Reads an engine configuration of comma-separated key=value settings:
+ * depth, time (ms per game), hash (MB), threads, exact and wld (empties
+ * at which the endgame is solved), probcut (threshold, 0 for none), ponder
+ * (1 to think on the opponent's time), eval (disc or pattern) and book
+ * (file).
+ * Returns false on anything it doesn't recognize.
+ */
+static bool parseEngine(char *spec, EngineConfig *config) {
+    config->depth = DEFAULT_DEPTH;
+    config->gameTime = 0;
+    config->hashMB = MATCH_TT_MB;
+    config->threads = 1;
+    config->exactEmpties = DEFAULT_EXACT_EMPTIES;
+    config->wldEmpties = DEFAULT_WLD_EMPTIES;
+    config->probCut = DEFAULT_PROBCUT_THRESHOLD;
+    config->ponder = false;
+    config->discCount = false;
+    config->bookFile = NULL;
+
+    for (char *item = strtok(spec, ","); item; item = strtok(NULL, ",")) {
+        char *value = strchr(item, '=');
+        if (!value) return false;
+        *value++ = '\0';
+        if (!strcmp(item, "depth")) config->depth = atoi(value);
+        else if (!strcmp(item, "time")) config->gameTime = atoi(value);
+        else if (!strcmp(item, "hash")) config->hashMB = atoi(value);
+        else if (!strcmp(item, "threads")) config->threads = atoi(value);
+        else if (!strcmp(item, "exact")) config->exactEmpties = atoi(value);
+        else if (!strcmp(item, "wld")) config->wldEmpties = atoi(value);
+        else if (!strcmp(item, "probcut")) config->probCut = atof(value);
+        else if (!strcmp(item, "ponder")) config->ponder = atoi(value) != 0;
+        else if (!strcmp(item, "eval") && !strcmp(value, "disc"))
+            config->discCount = true;
+        else if (!strcmp(item, "eval") && !strcmp(value, "pattern"))
+            config->discCount = false;
+        else if (!strcmp(item, "book")) config->bookFile = value;
+        else return false;
+    }
+    return true;
+}
+
+/*
+ * Reads opening positions, one per line in the batch analysis format (see
+ * recordFromLine()). Blank lines and lines starting with '#' are skipped;
+ * any other line that isn't a position is an error.
+ */
+static bool readOpenings(const char *filename, vector<Opening> *openings) {
+    FILE *file = fopen(filename, "r");
+    if (!file) return false;
+    char line[256];
+    int number = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), file)) {
+        number++;
+        char *start = line;
+        while (isspace((unsigned char) *start)) start++;
+        if (*start == '\0' || *start == '#') continue;
+
+        PositionRecord record;
+        if (!recordFromLine(line, &record)) {
+            fprintf(stderr, "%s:%d: not a position\n", filename, number);
+            ok = false;
+            break;
+        }
+        Opening opening;
+        opening.side = recordToBoard(&record, &opening.board);
+        openings->push_back(opening);
+    }
+    fclose(file);
+    return ok && !openings->empty();
+}
+
+/*
+ * Makes a random opening from the start position. Each opening number
+ * always gives the same position, whichever thread asks for it.
+ */
+static Opening randomOpening(int number, int plies) {
+    uint64_t state = 0x9e3779b97f4a7c15 * (number + 1);
+    Opening opening;
+    opening.side = BLACK;
+    for (int ply = 0; ply < plies; ply++) {
+        uint64_t moves = opening.board.legalMoves(opening.side);
+        if (moves == 0) break;
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        for (int k = state % popCount(moves); k > 0; k--)
+            moves &= moves - 1;
+        opening.board.makeMove(firstSquare(moves), opening.side);
+        opening.side = opponent(opening.side);
+    }
+    return opening;
+}
+
+/*
+ * Makes a player for one side, to be reused game after game.
+ */
+static Player *makePlayer(EngineConfig *config, Side side) {
+    Player *player = new Player(side, new Board());
+    player->tt.resize(config->hashMB);
+    player->search.setThreads(config->threads);
+    player->searchDepth = config->depth;
+    player->search.exactEmpties = config->exactEmpties;
+    player->search.wldEmpties = config->wldEmpties;
+    player->search.probCut = config->probCut;
+    player->ponder = config->ponder;
+    player->search.discCountEval = config->discCount;
+    if (config->bookFile) player->book.open(config->bookFile);
+    return player;
+}
+
+/*
+ * Plays one game from the opening and returns black's disc lead at the
+ * end. A player that runs out of time or makes an illegal move loses by
+ * the full 64 discs.
+ */
+static int playGame(Player *black, EngineConfig *blackConfig, Player *white,
+                    EngineConfig *whiteConfig, Opening *opening) {
+    Player *players[2];
+    players[BLACK] = black;
+    players[WHITE] = white;
+    int gameTime[2];
+    gameTime[BLACK] = blackConfig->gameTime;
+    gameTime[WHITE] = whiteConfig->gameTime;
+    int msLeft[2];
+    for (int i = 0; i < 2; i++) {
+        *players[i]->board = opening->board;
+        players[i]->tt.clear();
+        msLeft[i] = gameTime[i] ? gameTime[i] : -1;
+    }
+
+    Board board = opening->board;
+    Side side = opening->side;
+    Move *last = NULL;
+    int result = 0;
+    bool forfeit = false;
+    while (!board.isDone()) {
+        long start = nowMs();
+        Move *move = players[side]->doMove(last, msLeft[side]);
+        if (gameTime[side]) {
+            msLeft[side] -= nowMs() - start;
+            forfeit = (msLeft[side] < 0);
+        }
+        forfeit = forfeit || !board.checkMove(move, side);
+        if (forfeit) {
+            result = (side == BLACK) ? -64 : 64;
+            delete move;
+            break;
+        }
+        if (move) board.doMove(move, side);
+        delete last;
+        last = move;
+        side = opponent(side);
+    }
+    delete last;
+    black->stopPonder();
+    white->stopPonder();
+
+    if (!forfeit) result = board.count(BLACK) - board.count(WHITE);
+    return result;
+}
+
+/*
+ * Expected score for an Elo difference.
+ */
+static double expectedScore(double elo) {
+    return 1 / (1 + pow(10, -elo / 400));
+}
+
+/*
+ * Elo difference for an expected score strictly between 0 and 1.
+ */
+static double eloFromScore(double score) {
+    if (score < 1e-6) score = 1e-6;
+    if (score > 1 - 1e-6) score = 1 - 1e-6;
+    return -400 * log10(1 / score - 1);
+}
+
+/*
+ * Elo difference of the first engine with its 95% error margin, and the
+ * SPRT log-likelihood ratio of elo1 against elo0, using the normal
+ * approximation to the game results. Must be called with the lock held.
+ */
+static void statistics(Match *match, double *elo, double *margin,
+                       double *llr) {
+    int n = match->wins + match->draws + match->losses;
+    *elo = *margin = *llr = 0;
+    if (n == 0) return;
+    double mean = (match->wins + 0.5 * match->draws) / n;
+    double variance = (match->wins + 0.25 * match->draws) / n - mean * mean;
+    double deviation = sqrt(variance / n);
+    *elo = eloFromScore(mean);
+    *margin = (eloFromScore(mean + 1.96 * deviation)
+               - eloFromScore(mean - 1.96 * deviation)) / 2;
+    if (variance > 0) {
+        double s0 = expectedScore(match->elo0);
+        double s1 = expectedScore(match->elo1);
+        *llr = n * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+    }
+}
+
+/*
+ * Prints the results so far.
+ */
+static void report(Match *match, FILE *out) {
+    double elo, margin, llr;
+    statistics(match, &elo, &margin, &llr);
+    fprintf(out, "games %d: +%d =%d -%d, elo %+.1f +/- %.1f",
+            match->wins + match->draws + match->losses, match->wins,
+            match->draws, match->losses, elo, margin);
+    if (match->sprt) {
+        fprintf(out, ", llr %.2f (%.2f, %.2f)", llr,
+                log(match->beta / (1 - match->alpha)),
+                log((1 - match->beta) / match->alpha));
+    }
+    fprintf(out, "\n");
+}
+
+/*
+ * Plays games until the match is over. Games come in pairs from the same
+ * opening with colours swapped; the first engine is black in even games.
+ */
+static void *matchThread(void *arg) {
+    Match *match = (Match *) arg;
+
+    // players[e][side] is engine e playing side.
+    Player *players[2][2];
+    for (int e = 0; e < 2; e++) {
+        players[e][BLACK] = makePlayer(&match->engines[e], BLACK);
+        players[e][WHITE] = makePlayer(&match->engines[e], WHITE);
+    }
+
+    pthread_mutex_lock(&match->lock);
+    while (!match->stopped && match->nextGame < match->maxGames) {
+        int game = match->nextGame++;
+        pthread_mutex_unlock(&match->lock);
+
+        int pair = game / 2;
+        Opening opening = match->openings.empty()
+            ? randomOpening(pair, match->randomPlies)
+            : match->openings[pair % match->openings.size()];
+        int first = game % 2;
+        int second = 1 - first;
+        int lead = playGame(players[first][BLACK], &match->engines[first],
+                            players[second][WHITE], &match->engines[second],
+                            &opening);
+        if (first == 1) lead = -lead;
+
+        pthread_mutex_lock(&match->lock);
+        if (lead > 0) match->wins++;
+        else if (lead < 0) match->losses++;
+        else match->draws++;
+
+        int played = match->wins + match->draws + match->losses;
+        if (played % REPORT_INTERVAL == 0) report(match, stderr);
+        if (match->sprt) {
+            double elo, margin, llr;
+            statistics(match, &elo, &margin, &llr);
+            if (llr <= log(match->beta / (1 - match->alpha))
+                || llr >= log((1 - match->beta) / match->alpha))
+                match->stopped = true;
+        }
+    }
+    pthread_mutex_unlock(&match->lock);
+
+    for (int e = 0; e < 2; e++) {
+        delete players[e][BLACK];
+        delete players[e][WHITE];
+    }
+    return NULL;
+}
+
+/*
+ * Plays two engine configurations against each other in-process, several
+ * games at a time, and reports the first engine's Elo difference with a
+ * 95% error margin. With --sprt the match stops as soon as the sequential
+ * probability ratio test accepts either elo0 or elo1.
+ *
+ * Engines are given as comma-separated settings, e.g. "depth=6" or
+ * "time=20000,hash=32"; see parseEngine(). Both engines share the
+ * evaluation weights loaded at startup.
+ *
+ * usage: match ENGINE1 ENGINE2 [--games N] [--threads N] [--plies N]
+ *              [--openings FILE] [--sprt ELO0 ELO1] [--alpha A] [--beta B]
+ */
+int main(int argc, char *argv[]) {
+    Match match;
+    match.randomPlies = DEFAULT_RANDOM_PLIES;
+    match.maxGames = 1000;
+    match.sprt = false;
+    match.elo0 = 0;
+    match.elo1 = 5;
+    match.alpha = match.beta = 0.05;
+    int threads = 1;
+
+    bool badArgs = (argc < 3) || !parseEngine(argv[1], &match.engines[0])
+        || !parseEngine(argv[2], &match.engines[1]);
+    for (int i = 3; i < argc && !badArgs; i++) {
+        if (!strcmp(argv[i], "--games") && i + 1 < argc) {
+            match.maxGames = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--plies") && i + 1 < argc) {
+            match.randomPlies = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--openings") && i + 1 < argc) {
+            if (!readOpenings(argv[++i], &match.openings)) {
+                fprintf(stderr, "could not read openings from %s\n",
+                        argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--sprt") && i + 2 < argc) {
+            match.sprt = true;
+            match.elo0 = atof(argv[++i]);
+            match.elo1 = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--alpha") && i + 1 < argc) {
+            match.alpha = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--beta") && i + 1 < argc) {
+            match.beta = atof(argv[++i]);
+        } else {
+            badArgs = true;
+        }
+    }
+    if (badArgs) {
+        fprintf(stderr, "usage: %s ENGINE1 ENGINE2 [--games N] [--threads N]"
+                " [--plies N]\n       [--openings FILE] [--sprt ELO0 ELO1]"
+                " [--alpha A] [--beta B]\n", argv[0]);
+        return 1;
+    }
+    if (threads < 1) threads = 1;
+
+    Eval::loadWeights(WEIGHTS_FILE);
+    ProbCut::load(PROBCUT_FILE);
+    pthread_mutex_init(&match.lock, NULL);
+    match.nextGame = 0;
+    match.wins = match.draws = match.losses = 0;
+    match.stopped = false;
+
+    long start = nowMs();
+    vector<pthread_t> threadIds(threads);
+    for (int i = 0; i < threads; i++)
+        pthread_create(&threadIds[i], NULL, matchThread, &match);
+    for (int i = 0; i < threads; i++)
+        pthread_join(threadIds[i], NULL);
+
+    report(&match, stdout);
+    if (match.sprt && match.stopped) {
+        double elo, margin, llr;
+        statistics(&match, &elo, &margin, &llr);
+        printf("sprt: %s accepted\n", llr > 0 ? "H1 (elo1)" : "H0 (elo0)");
+    }
+    printf("%.1f s\n", (nowMs() - start) / 1000.0);
+    pthread_mutex_destroy(&match.lock);
+    return 0;
+}
@@ -18,6 +18,16 @@ Player::Player(Side side) {
     board = new Board();
     us = side;
     them = (us == BLACK) ? WHITE : BLACK;
+    searchDepth = DEFAULT_DEPTH;
+    search.tt = &tt;
+    ponder = false;
+    ponderHits = 0;
+    searches = 0;
+    statsLog = NULL;
+    tracePrefix = NULL;
+    pondering = false;
+    ponderMove = -1;
+    ponderDepth = 0;
 
 }
 
@@ -27,9 +37,20 @@ Player::Player(Side side) {
  * The constructor must finish within 30 seconds.
  */
 Player::Player(Side side, Board *b) {
+    testingMinimax = false;
     board = b;
     us = side;
     them = (us == BLACK) ? WHITE : BLACK;
+    searchDepth = DEFAULT_DEPTH;
+    search.tt = &tt;
+    ponder = false;
+    ponderHits = 0;
+    searches = 0;
+    statsLog = NULL;
+    tracePrefix = NULL;
+    pondering = false;
+    ponderMove = -1;
+    ponderDepth = 0;
 }
 
 /*
@@ -39,6 +60,7 @@ Player::~Player() {
 
     // comment from Zach to change this file
     // comment from Aritra
+    stopPonder();
     delete board;
 
 }
@@ -66,16 +88,89 @@ Move *Player::doMove(Move *opponentsMove, int msLeft) {
             std::cerr << "Opponent made a move, I updated" << std::endl;
     }
 
-    // Pick our ideal moves
-    if (verbose)
-        std::cerr << "Trying to pick a move" << std::endl;
-    MovePair *moves = pickMove(board, 3, verbose);
-    if (verbose)
-        std::cerr << "Got moves" << std::endl;
-    Move *m = moves->first;
+    // A ponder search on the reply they actually made is already our
+    // search; on any other reply it is of no more use.
+    bool ponderHit = false;
+    if (pondering) {
+        int reply = opponentsMove ? opponentsMove->x + 8 * opponentsMove->y
+                                  : -1;
+        ponderHit = (reply == ponderMove);
+        if (verbose)
+            std::cerr << "Ponder " << (ponderHit ? "hit" : "miss") << std::endl;
+    }
+
+    // Play straight from the opening book when it knows the position
+    BookEntry entry;
+    if (!testingMinimax && book.probe(board, us, &entry)) {
+        stopPonder();
+        Move *m = new Move(entry.move % 8, entry.move / 8);
+        if (verbose) {
+            std::cerr << "Book move: (" << m->getX() << ", " << m->getY()
+            << "), score " << entry.score << std::endl;
+        }
+        board->doMove(m, us);
+        return m;
+    }
+    if (!ponderHit) stopPonder();
+
+    // Budget this move from the time left; without a time limit search to
+    // a fixed depth instead. On a ponder hit the running search goes on
+    // with this budget, counted from now.
+    int empties = 64 - board->count(BLACK) - board->count(WHITE);
+    timer.start(msLeft, empties);
+    int depth = timer.unlimited ? searchDepth : MAX_DEPTH;
+    TimeManager *clock = &timer;
+    if (verbose && !timer.unlimited) {
+        std::cerr << "Time left " << msLeft << " ms, aiming for "
+        << timer.softLimit << " ms, at most " << timer.hardLimit << " ms"
+        << std::endl;
+    }
+
+    // The minimax test wants a plain 2-ply search on disc count
+    if (testingMinimax) {
+        search.discCountEval = true;
+        depth = 2;
+        clock = NULL;
+    }
+
+    // Pick our ideal move
+    SearchResult result;
+    if (ponderHit) {
+        pthread_join(ponderThread, NULL);
+        pondering = false;
+        ponderHits++;
+        result = ponderResult;
+    }
+    else {
+        if (verbose)
+            std::cerr << "Trying to pick a move" << std::endl;
+        search.verbose = verbose;
+        searches++;
+        result = search.run(board, us, depth, clock);
+    }
+    if (verbose) {
+        std::cerr << "Searched " << result.nodes << " nodes to depth "
+        << result.depth << ", score " << result.score << std::endl;
+    }
+    if (statsLog) {
+        search.writeStatsLine(statsLog);
+        fflush(statsLog);
+    }
+    if (tracePrefix) {
+        char filename[FILENAME_MAX];
+        snprintf(filename, sizeof(filename), "%s%d.json", tracePrefix,
+                 60 - empties);
+        FILE *trace = fopen(filename, "w");
+        if (trace) {
+            search.writeTrace(trace);
+            fclose(trace);
+        }
+    }
 
     // Make it
-    if (m) {
+    Move *m = NULL;
+    if (result.move >= 0) {
+        m = new Move(result.move % 8, result.move / 8);
         if (verbose)
             std::cerr << "Doing move: (" << m->getX() << ", " << m->getY() << ")" << std::endl;
         board->doMove(m, us);
@@ -85,266 +180,147 @@ Move *Player::doMove(Move *opponentsMove, int msLeft) {
             std::cerr << "Couldn't find valid move" << std::endl;
     }
 
-    // Clean up and return a pointer to our move
-    if (moves->second)
-        delete moves->second;
-    delete moves;
+    // Think about our next move while they think about theirs
+    if (ponder && !testingMinimax)
+        startPonder(&result, msLeft);
+
     if (verbose)
         std::cerr << "Returning move" << std::endl;
     return m;
     
 }
 
-MovePair *Player::pickMove(Board *start_board, int depth, bool verbose) {
+/*
+ * Starts searching, on a background thread, the position after the reply
+ * our last search expects: the second move of its principal variation or,
+ * failing that, the transposition table move. The search runs on our
+ * clock without a limit until the reply comes in, or, without a game
+ * clock, to the usual fixed depth. Does nothing if there's no legal reply
+ * to expect or the game would be over.
+ */
+void Player::startPonder(SearchResult *result, int msLeft) {
+    int reply = -2;
+    uint64_t replies = board->legalMoves(them);
+    if (result->pvLength >= 2) {
+        reply = result->pv[1];
+    }
+    else {
+        TTEntry entry;
+        if (tt.probe(board->hashKey(them), &entry)) reply = entry.move;
+    }
+    if (reply == -1 && replies) return;
+    if (reply != -1 && (reply < 0 || !((replies >> reply) & 1))) return;
+
+    ponderBoard = *board;
+    if (reply >= 0) ponderBoard.makeMove(reply, them);
+    if (ponderBoard.isDone()) return;
+
+    ponderMove = reply;
+    ponderDepth = (msLeft < 0) ? searchDepth : MAX_DEPTH;
+    timer.start(-1, 0);
+    pondering = true;
+    pthread_create(&ponderThread, NULL, ponderMain, this);
+}
+
+/*
+ * Thread entry point for the ponder search.
+ */
+void *Player::ponderMain(void *arg) {
+    Player *player = (Player *) arg;
+    player->ponderResult = player->search.run(&player->ponderBoard,
+        player->us, player->ponderDepth, &player->timer);
+    return NULL;
+}
+
+/*
+ * Stops the ponder search, if there is one, and waits for it to finish.
+ */
+void Player::stopPonder() {
+    if (!pondering) return;
+    timer.stop();
+    pthread_join(ponderThread, NULL);
+    pondering = false;
+}
 
-    int movesmade = 0; 
-    int movesdelete = 0;
+/*
+ * The original full-width minimax: looks depth pairs of moves ahead and
+ * returns our best move and their expected reply. No longer used by
+ * doMove(); kept to play against the search engine. Works on board copies
+ * and square values only, so it allocates nothing.
+ */
+MovePair Player::pickMove(Board *start_board, int depth, bool verbose) {
+    MovePair result = { -1, -1 };
 
     // Sanity check for depth argument
     if (depth < 1) {
         std::cerr << "  FATAL ERROR: pickMove() called with depth < 1" << std::endl;
-        return NULL;
+        return result;
     }
 
+    uint64_t our_moves = start_board->legalMoves(us);
     if (verbose)
-        std::cerr << "  MEMORY: Received start_board at " << start_board << std::endl;
-    
-    // Get our valid moves
-    std::vector<Move *> our_moves;
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            Move *here = new Move(i, j); movesmade++;
-            if (start_board->checkMove(here, us)) {
-                our_moves.push_back(here);
-            }
-            else { delete here; movesdelete++; }
-        }
-    }
-    if (verbose)
-        std::cerr << "  Found " << our_moves.size() << " valid moves" << std::endl;
-    
-    // Prepare struct for output
-    MovePair* moves = new MovePair;
-
-    // Handle trivial base case
-    if (our_moves.size() == 0) { // No moves
-        moves->first = NULL;
-        moves->second = NULL;
-        return moves;
-    }
-    if (verbose)
-        std::cerr << "  Nontrivial case, predicting opponent moves" << std::endl;
+        std::cerr << "  Found " << popCount(our_moves) << " valid moves" << std::endl;
 
-    // Prepare to find our ideal move
     int score_max = TINY_SCORE; // After their ideal move
-    Move *our_ideal_m = NULL;
-
-    // Prepare ahead to find their ideal move
-    Move *their_ideal_m = NULL;
 
     // For each of our moves...
-    for (unsigned int i = 0; i < our_moves.size(); i++) {
-
-        // Update our working board with our move
-        Move *our_m = our_moves[i];
-        if (verbose)
-            std::cerr << "    Considering our move (" << our_m->getX()
-        << ", " << our_m->getY() << ")" << std::endl;
-        Board *our_work_board = start_board->copy();
+    for (; our_moves; our_moves &= our_moves - 1) {
+        int our_m = firstSquare(our_moves);
         if (verbose) {
-            std::cerr << "      MEMORY: Created our_work_board (copied start_board) at "
-            << our_work_board << std::endl;
+            std::cerr << "    Considering our move (" << our_m % 8
+            << ", " << our_m / 8 << ")" << std::endl;
         }
-        our_work_board->doMove(our_m, us);
-
-        // Get their valid moves
-        std::vector<Move *> their_moves;
-        for (int j = 0; j < 8; j++) {
-            for (int k = 0; k < 8; k++) {
-                Move *here = new Move(j, k); movesmade++;
-                if (our_work_board->checkMove(here, us)) {
-                    their_moves.push_back(here);
-                }
-                else { delete here; movesdelete++; }
-            }
-        }
-        if (verbose)
-            std::cerr << "      Opponent has " << their_moves.size() << " valid countermoves" << std::endl;
-        
-        // Prepare to find their ideal move
-        int score_min = HUGE_SCORE; // After their trial move
-        Move *their_ideal_m_for_ours = NULL;
-
-        // For each of their moves...
-        for (unsigned int j = 0; j < their_moves.size(); j++) {
-                
-            // Update their working board with their move
-            Move *their_m = their_moves[j];
-            if (verbose) {
-                std::cerr << "      Considering their move (" << their_m->getX()
-                << ", " << their_m->getY() << ")" << std::endl;
-            }
-            Board* their_work_board = our_work_board->copy();
-            if (verbose) {
-                std::cerr << "        MEMORY: Created their_work_board (copied our_work_board) at "
-                << their_work_board << std::endl;
-            }
-            their_work_board->doMove(their_m, them);
+        Board our_work_board = *start_board;
+        our_work_board.makeMove(our_m, us);
 
-            // If requested, recursively get next two moves and update their working board
+        // Find their reply that leaves us the lowest score
+        int score_min = HUGE_SCORE; // After their trial move
+        int their_ideal_m = -1;
+        uint64_t their_moves = our_work_board.legalMoves(them);
+        for (; their_moves; their_moves &= their_moves - 1) {
+            int their_m = firstSquare(their_moves);
+            Board their_work_board = our_work_board;
+            their_work_board.makeMove(their_m, them);
+
+            // If requested, recursively play the next two moves as well
             if (depth > 1) {
-
-                if (verbose)
-                    std::cerr << "        Attempting recursion" << std::endl;
-
-                MovePair* next_moves = pickMove(their_work_board, depth - 1, verbose);
-                
-                if (verbose)
-                    std::cerr << "        Recursion returned:" << std::endl;
-
-                if (next_moves->first) { // Our next ideal move exists
-                    
-                    if (verbose) {
-                        std::cerr << "          Our ideal move: ("
-                        << next_moves->first->getX() << ", "
-                        << next_moves->first->getY() << ")"
-                        << std::endl;
-                    }
-                    
-                    their_work_board->doMove(next_moves->first, us);
-
-                }
-                else {
-                    if (verbose)
-                        std::cerr << "          No ideal move for us" << std::endl;
-                }
-                if (next_moves->second) { // Their next ideal countermove exists
-                    
-                    if (verbose) {
-                        std::cerr << "          Their ideal countermove: ("
-                        << next_moves->second->getX() << ", "
-                        << next_moves->second->getY() << ")"
-                        << std::endl;
-                    }
-                    
-                    their_work_board->doMove(next_moves->second, them);
-
-                }
-                else {
-                    if (verbose)
-                        std::cerr << "          No ideal countermove for them" << std::endl;
-                }
-
-
-                delete next_moves;
-
+                MovePair next_moves = pickMove(&their_work_board, depth - 1,
+                                               verbose);
+                if (next_moves.first >= 0)
+                    their_work_board.makeMove(next_moves.first, us);
+                if (next_moves.second >= 0)
+                    their_work_board.makeMove(next_moves.second, them);
             }
 
-            // Update their ideal move using their working board
-            if (their_work_board->score(us) < score_min) {
-                if (verbose)
-                   std::cerr << "        Their best move so far" << std::endl;
-                score_min = their_work_board->score(us); // New minimum score
-                their_ideal_m_for_ours = their_m;
+            if (their_work_board.score(us) < score_min) {
+                score_min = their_work_board.score(us); // New minimum score
+                their_ideal_m = their_m;
             }
-
-        
-            // Clean up everything used for this one of their moves
-            if (verbose)
-                std::cerr << "        MEMORY: Deleting their_work_board at " << their_work_board << std::endl;
-            delete their_work_board;
-            if (verbose)
-                std::cerr << "        MEMORY: Deleted their_work_board successfully " << std::endl;
-
         }
-        
-        // Set up score
-        Move *their_ideal_m_for_ours_OUT = NULL;
-        if (their_moves.size() > 0) { // They had countermoves
-
-            // Copy move
-            their_ideal_m_for_ours_OUT = new Move(-1, -1); movesmade++;
-            their_ideal_m_for_ours_OUT->setX(their_ideal_m_for_ours->getX());
-            their_ideal_m_for_ours_OUT->setY(their_ideal_m_for_ours->getY());
-            
-            // Update work board with their ideal countermove for this one of our moves
-            our_work_board->doMove(their_ideal_m_for_ours_OUT, them);
-
-            // their_ideal_m_for_ours_OUT is already filled
-
-            // Delete memory allocated to all their moves
-            for (unsigned int w = 0; w < their_moves.size(); w++) {
-                delete their_moves[w];
-                movesdelete++;
-            }
-
-        }
-        else { // They had no countermoves
-
-            // Work board is already updated
-
-            // They have no ideal countermove for this one of our moves
-            their_ideal_m_for_ours_OUT = NULL;
 
-        }
-        // Found their ideal move
+        // Play their ideal countermove for this one of our moves
+        if (their_ideal_m >= 0)
+            our_work_board.makeMove(their_ideal_m, them);
         if (verbose) {
-            std::cerr << "      Opponent will do: (" << their_ideal_m_for_ours_OUT->getX()
-            << ", " << their_ideal_m_for_ours_OUT->getY() << ")" << std::endl;
+            if (their_ideal_m < 0)
+                std::cerr << "      Opponent has no countermoves" << std::endl;
+            else
+                std::cerr << "      Opponent will do: (" << their_ideal_m % 8
+                << ", " << their_ideal_m / 8 << ")" << std::endl;
         }
 
         // Update our ideal move
-        if (our_work_board->score(us) > score_max) {
-            if (verbose)
-                std::cerr << "      Our best move so far" << std::endl;
-            score_max = our_work_board->score(us); // New maximum score
-            our_ideal_m = our_m;
-            their_ideal_m = their_ideal_m_for_ours_OUT;
-        }
-
-        // Clean up everything used to calculate for this one of our moves
-        if (verbose)
-            std::cerr << "      MEMORY: Deleting our_work_board at " << our_work_board << std::endl;
-        delete our_work_board;
-        if (verbose)
-            std::cerr << "      MEMORY: Deleted our_work_board succesfully" << std::endl;
-
-    }
-
-    // Return move pair
-    if (verbose) {
-        std::cerr << "  Returning moves!" << std::endl;
-        std::cerr << "  We will do: (" << our_ideal_m->getX() << ", " << our_ideal_m->getY() << ")" << std::endl;
-        if (their_ideal_m) {
-            std::cerr << "  They should do: (" << their_ideal_m->getX() << ", "
-            << their_ideal_m->getY() << ")" << std::endl;
-        }
-        else {
-            std::cerr << "  They will have no countermoves" << std::endl;
+        if (our_work_board.score(us) > score_max) {
+            score_max = our_work_board.score(us); // New maximum score
+            result.first = our_m;
+            result.second = their_ideal_m;
         }
-        std::cerr << "  Putting our move into output package" << std::endl; 
     }
 
-    Move *our_ideal_m_OUT = NULL;
-    if (our_moves.size() > 0) {
-        
-        // Copy move
-        our_ideal_m_OUT = new Move(-1, -1); movesmade++;
-        our_ideal_m_OUT->setX(our_ideal_m->getX());
-        our_ideal_m_OUT->setY(our_ideal_m->getY());
-
-    }
-    for (unsigned int ww = 0; ww < our_moves.size(); ww++) {
-        delete our_moves[ww];
-        movesdelete++;
-    }
-
-    moves->first = our_ideal_m_OUT;
-    if (verbose) {
-        std::cerr << "  Putting their expected move into output package" << std::endl; 
-        std::cerr << "  Moves leaked = " << movesmade - movesdelete << std::endl;
+    if (verbose && result.first >= 0) {
+        std::cerr << "  We will do: (" << result.first % 8 << ", "
+        << result.first / 8 << ")" << std::endl;
     }
-    moves->second = their_ideal_m;
-    return moves;
+    return result;
 
 }
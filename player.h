@@ -4,16 +4,26 @@
 #include <iostream>
 #include <cstdlib>
 #include <vector>
+#include <pthread.h>
 #include "common.h"
 #include "board.h"
+#include "search.h"
+#include "book.h"
 using namespace std;
 
 #define HUGE_SCORE 1000
 #define TINY_SCORE -1000
 
+// Plies searched per move by doMove() when there is no time limit
+#define DEFAULT_DEPTH 8
+
+// Deepest search doMove() will attempt when it is timed
+#define MAX_DEPTH 60
+
+// Our move and the reply we expect, -1 where there is none.
 struct MovePair {
-    Move *first;
-    Move *second;
+    int first;
+    int second;
 };
 
 class Player {
@@ -28,11 +38,42 @@ public:
     Board *board; // The board state for this player
 
     Move *doMove(Move *opponentsMove, int msLeft);
-    MovePair *pickMove(Board *start_board, int depth, bool verbose);
+    MovePair pickMove(Board *start_board, int depth, bool verbose);
+    void stopPonder();
+
+    Search search; // The search engine used by doMove
+    TimeManager timer; // Decides how long each move may take
+    TranspositionTable tt; // Search results kept from move to move
+    OpeningBook book; // Moves played without searching, if open
+    int searchDepth; // How many plies doMove searches with no time limit
 
     // Flag to tell if the player is running within the test_minimax context
     bool testingMinimax;
 
+    // Search the opponent's expected reply while they think
+    bool ponder;
+    int ponderHits; // Moves played from a ponder search
+    int searches;   // Searches doMove() started itself, for other moves
+
+    // If set, every search appends a JSON line of statistics to statsLog,
+    // and writes a Chrome trace to tracePrefix + ply + ".json".
+    FILE *statsLog;
+    const char *tracePrefix;
+
+private:
+    // The background search started after our last move, if any: the
+    // reply it expects (-1 for a pass), the position after that reply and
+    // what it found.
+    bool pondering;
+    pthread_t ponderThread;
+    int ponderMove;
+    int ponderDepth;
+    Board ponderBoard;
+    SearchResult ponderResult;
+
+    void startPonder(SearchResult *result, int msLeft);
+    static void *ponderMain(void *arg);
+
 };
 
 
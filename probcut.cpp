@@ -0,0 +1,198 @@
+#include <cstdio>
+#include <cstring>
+#include "probcut.h"
+
+static ProbCutCheck checks[NUM_PHASES][PROBCUT_MAX_DEPTH + 1][PROBCUT_CHECKS];
+
+// Deepest remaining depth in the built-in parameters.
+#define DEFAULT_CALIBRATED_DEPTH 10
+
+/*
+ * The built-in fits, {a, b, sigma} per phase, depth from PROBCUT_MIN_DEPTH
+ * to DEFAULT_CALIBRATED_DEPTH and check, as printed by "calibrate 800 10"
+ * with the default evaluation. Checks with no shallow depth are unused.
+ */
+static const float DEFAULT_PARAMS[NUM_PHASES]
+    [DEFAULT_CALIBRATED_DEPTH - PROBCUT_MIN_DEPTH + 1][PROBCUT_CHECKS][3] = {
+    { // phase 0
+        { { 0.987f, 2.13f, 5.38f }, { 1.000f, 0.00f, 0.00f } },
+        { { 0.988f, -0.34f, 4.48f }, { 1.000f, 0.00f, 0.00f } },
+        { { 1.004f, 2.78f, 6.31f }, { 1.014f, 0.62f, 3.51f } },
+        { { 0.997f, -0.48f, 5.55f }, { 1.007f, -0.15f, 3.42f } },
+        { { 0.979f, 2.73f, 7.21f }, { 0.999f, 0.60f, 4.38f } },
+        { { 1.010f, -0.09f, 6.27f }, { 1.020f, 0.25f, 4.43f } },
+        { { 1.030f, 0.75f, 5.46f }, { 1.016f, 0.12f, 4.13f } },
+        { { 1.024f, 0.28f, 7.00f }, { 1.032f, 0.79f, 3.66f } }
+    },
+    { // phase 1
+        { { 1.015f, 2.84f, 7.76f }, { 1.000f, 0.00f, 0.00f } },
+        { { 1.075f, 0.66f, 8.05f }, { 1.000f, 0.00f, 0.00f } },
+        { { 1.092f, 3.31f, 11.63f }, { 1.088f, 0.19f, 7.02f } },
+        { { 1.124f, 1.00f, 12.18f }, { 1.073f, 0.26f, 6.24f } },
+        { { 1.147f, 3.74f, 14.40f }, { 1.143f, 0.46f, 10.62f } },
+        { { 1.190f, 1.61f, 15.63f }, { 1.153f, 0.79f, 9.81f } },
+        { { 1.223f, 0.69f, 13.89f }, { 1.156f, 0.27f, 8.73f } },
+        { { 1.277f, 1.71f, 18.60f }, { 1.185f, 0.44f, 7.93f } }
+    },
+    { // phase 2
+        { { 1.055f, 2.97f, 12.28f }, { 1.000f, 0.00f, 0.00f } },
+        { { 1.059f, 0.46f, 11.82f }, { 1.000f, 0.00f, 0.00f } },
+        { { 1.119f, 3.98f, 18.70f }, { 1.066f, 0.80f, 12.19f } },
+        { { 1.145f, -0.30f, 18.18f }, { 1.085f, -0.81f, 11.62f } },
+        { { 1.215f, 4.25f, 25.23f }, { 1.163f, 0.75f, 18.91f } },
+        { { 1.227f, -0.59f, 24.53f }, { 1.177f, -1.09f, 17.73f } },
+        { { 1.245f, 1.75f, 25.84f }, { 1.191f, 0.77f, 17.72f } },
+        { { 1.321f, 0.42f, 31.48f }, { 1.184f, 0.71f, 18.63f } }
+    },
+    { // phase 3
+        { { 1.105f, 1.48f, 19.90f }, { 1.000f, 0.00f, 0.00f } },
+        { { 1.146f, 2.20f, 17.52f }, { 1.000f, 0.00f, 0.00f } },
+        { { 1.210f, 2.08f, 28.87f }, { 1.101f, 0.34f, 15.93f } },
+        { { 1.257f, 5.59f, 24.73f }, { 1.100f, 3.15f, 13.70f } },
+        { { 1.337f, 1.55f, 38.70f }, { 1.227f, -0.58f, 24.69f } },
+        { { 1.348f, 8.83f, 34.45f }, { 1.193f, 6.67f, 25.40f } },
+        { { 1.313f, 1.79f, 35.74f }, { 1.204f, 1.18f, 25.83f } },
+        { { 1.445f, 15.55f, 44.16f }, { 1.184f, 9.47f, 24.74f } }
+    }
+};
+
+/*
+ * Loads the built-in parameters at startup.
+ */
+static struct ProbCutInit {
+    ProbCutInit() {
+        ProbCut::defaultParams();
+    }
+} probCutInit;
+
+/*
+ * The shallow depth of each check at a remaining depth: about a quarter
+ * and about half of it, always with the same parity, since odd and even
+ * depth scores differ in Othello. Returns 0 if there is no such check.
+ */
+int ProbCut::shallowDepth(int depth, int check) {
+    int shallow = (check == 0) ? depth / 4 : depth / 2;
+    if (shallow < 1) shallow = 1;
+    if ((depth - shallow) & 1) shallow++;
+    if (shallow > depth - 2) return 0;
+    if (check > 0 && shallow <= shallowDepth(depth, check - 1)) return 0;
+    return shallow;
+}
+
+/*
+ * The parameters of one check, or NULL if it isn't calibrated.
+ */
+ProbCutCheck *ProbCut::check(int phase, int depth, int check) {
+    if (depth < PROBCUT_MIN_DEPTH || depth > PROBCUT_MAX_DEPTH) return NULL;
+    ProbCutCheck *c = &checks[phase][depth][check];
+    return (c->sigma > 0 && c->a > 0) ? c : NULL;
+}
+
+/*
+ * The parameters of one check whether calibrated or not, for filling in.
+ */
+ProbCutCheck *ProbCut::entry(int phase, int depth, int check) {
+    return &checks[phase][depth][check];
+}
+
+/*
+ * Sets the built-in parameters.
+ */
+void ProbCut::defaultParams() {
+    clear();
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+        for (int depth = PROBCUT_MIN_DEPTH; depth <= DEFAULT_CALIBRATED_DEPTH;
+             depth++) {
+            for (int i = 0; i < PROBCUT_CHECKS; i++) {
+                const float *p =
+                    DEFAULT_PARAMS[phase][depth - PROBCUT_MIN_DEPTH][i];
+                ProbCutCheck *c = &checks[phase][depth][i];
+                c->a = p[0];
+                c->b = p[1];
+                c->sigma = c->shallow ? p[2] : 0;
+            }
+        }
+    }
+    extend();
+}
+
+/*
+ * Marks every check as uncalibrated.
+ */
+void ProbCut::clear() {
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+        for (int depth = 0; depth <= PROBCUT_MAX_DEPTH; depth++) {
+            for (int i = 0; i < PROBCUT_CHECKS; i++) {
+                ProbCutCheck *c = &checks[phase][depth][i];
+                c->shallow = shallowDepth(depth, i);
+                c->a = 1;
+                c->b = 0;
+                c->sigma = 0;
+            }
+        }
+    }
+}
+
+/*
+ * Gives the depths past the deepest calibrated one the fit of that depth,
+ * check by check, so that deep searches prune too.
+ */
+void ProbCut::extend() {
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+        for (int i = 0; i < PROBCUT_CHECKS; i++) {
+            ProbCutCheck *last = NULL;
+            for (int depth = PROBCUT_MIN_DEPTH; depth <= PROBCUT_MAX_DEPTH;
+                 depth++) {
+                ProbCutCheck *c = &checks[phase][depth][i];
+                if (c->sigma > 0) last = c;
+                else if (last && c->shallow) {
+                    c->a = last->a;
+                    c->b = last->b;
+                    c->sigma = last->sigma;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Replaces the parameters with ones from a file written by save(), then
+ * extends them to deeper searches. Returns false, leaving the parameters
+ * alone, if the file is missing or doesn't match.
+ */
+bool ProbCut::load(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) return false;
+
+    uint32_t header[5];
+    ProbCutCheck data[NUM_PHASES][PROBCUT_MAX_DEPTH + 1][PROBCUT_CHECKS];
+    bool ok = fread(header, sizeof(header), 1, file) == 1
+        && header[0] == PROBCUT_MAGIC && header[1] == PROBCUT_VERSION
+        && header[2] == NUM_PHASES && header[3] == PROBCUT_MAX_DEPTH
+        && header[4] == PROBCUT_CHECKS
+        && fread(data, sizeof(data), 1, file) == 1;
+    fclose(file);
+    if (!ok) return false;
+
+    memcpy(checks, data, sizeof(checks));
+    extend();
+    return true;
+}
+
+/*
+ * Writes the parameters: a header of five 32-bit words (magic, version,
+ * phases, deepest depth, checks) followed by a ProbCutCheck for every
+ * phase, depth from 0 to PROBCUT_MAX_DEPTH and check.
+ */
+bool ProbCut::save(const char *filename) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) return false;
+
+    uint32_t header[5] = {
+        PROBCUT_MAGIC, PROBCUT_VERSION, NUM_PHASES, PROBCUT_MAX_DEPTH,
+        PROBCUT_CHECKS
+    };
+    bool ok = fwrite(header, sizeof(header), 1, file) == 1
+        && fwrite(checks, sizeof(checks), 1, file) == 1;
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,52 @@
+#ifndef __PROBCUT_H__
+#define __PROBCUT_H__
+
+#include <stdint.h>
+#include "common.h"
+#include "eval.h"
+
+// Cut parameter file read at startup if it exists, and its header.
+#define PROBCUT_FILE "probcut.bin"
+#define PROBCUT_MAGIC 0x4350544f // "OTPC" read as a little-endian word
+#define PROBCUT_VERSION 1
+
+// Multi-ProbCut is tried at remaining depths from PROBCUT_MIN_DEPTH to
+// PROBCUT_MAX_DEPTH, with up to PROBCUT_CHECKS shallow searches each.
+#define PROBCUT_MIN_DEPTH 3
+#define PROBCUT_MAX_DEPTH 40
+#define PROBCUT_CHECKS 2
+
+// How sure a cut has to be, in standard deviations of the regression
+// error. Higher prunes less; 0 turns Multi-ProbCut off.
+#define DEFAULT_PROBCUT_THRESHOLD 1.5
+
+/*
+ * How the score of a deep search follows from a shallow one in one game
+ * phase: deep = a * shallow + b, give or take a normally distributed error
+ * with standard deviation sigma. A sigma of 0 marks a pair with no data.
+ */
+struct ProbCutCheck {
+    int32_t shallow;
+    float a, b, sigma;
+};
+
+/*
+ * The Multi-ProbCut parameters, shared by every search. Each remaining
+ * depth has up to PROBCUT_CHECKS shallow depths to try, cheapest first,
+ * each fitted per phase by the calibrate tool. Depths past the deepest
+ * calibrated one reuse its fit.
+ */
+class ProbCut {
+
+public:
+    static int shallowDepth(int depth, int check);
+    static ProbCutCheck *check(int phase, int depth, int check);
+    static ProbCutCheck *entry(int phase, int depth, int check);
+    static void defaultParams();
+    static void clear();
+    static void extend();
+    static bool load(const char *filename);
+    static bool save(const char *filename);
+};
+
+#endif
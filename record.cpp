@@ -0,0 +1,300 @@
+#include <cctype>
+#include <cstring>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "record.h"
+
+static_assert(sizeof(PositionRecord) == 24, "PositionRecord must be packed");
+
+PositionWriter::PositionWriter() {
+    file = NULL;
+}
+
+PositionWriter::~PositionWriter() {
+    close();
+}
+
+/*
+ * Opens a file to append to. A new or empty file gets a header; returns
+ * false if the file has one that doesn't match, or is too short to have
+ * one at all, as after an interrupted write.
+ */
+bool PositionWriter::open(const char *filename) {
+    close();
+    file = fopen(filename, "a+b");
+    if (!file) return false;
+
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0) {
+        RecordHeader fresh = { RECORD_MAGIC, RECORD_VERSION,
+                               (uint32_t) sizeof(PositionRecord), 0 };
+        return fwrite(&fresh, sizeof(fresh), 1, file) == 1;
+    }
+
+    RecordHeader header;
+    fseek(file, 0, SEEK_SET);
+    if (fread(&header, sizeof(header), 1, file) == 1
+        && header.magic == RECORD_MAGIC && header.version == RECORD_VERSION
+        && header.recordSize == sizeof(PositionRecord))
+        return true;
+    close();
+    return false;
+}
+
+/*
+ * Appends one record.
+ */
+bool PositionWriter::write(const PositionRecord *record) {
+    return file && fwrite(record, sizeof(PositionRecord), 1, file) == 1;
+}
+
+/*
+ * Closes the file, returning false if anything failed to be written.
+ */
+bool PositionWriter::close() {
+    if (!file) return true;
+    bool ok = fclose(file) == 0;
+    file = NULL;
+    return ok;
+}
+
+PositionFile::PositionFile() {
+    map = NULL;
+    mapSize = 0;
+    first = NULL;
+    count = 0;
+}
+
+PositionFile::~PositionFile() {
+    close();
+}
+
+/*
+ * Maps a position file into memory, replacing any file already open.
+ * Returns false, leaving it empty, if the file can't be read or isn't a
+ * position file. A partial record at the end, from a writer that was cut
+ * off, is left out.
+ */
+bool PositionFile::open(const char *filename) {
+    close();
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(RecordHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+
+    RecordHeader *header = (RecordHeader *) data;
+    if (header->magic != RECORD_MAGIC || header->version != RECORD_VERSION
+        || header->recordSize != sizeof(PositionRecord)) {
+        munmap(data, st.st_size);
+        return false;
+    }
+    // Files are mostly read front to back.
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    map = data;
+    mapSize = st.st_size;
+    first = (const PositionRecord *) (header + 1);
+    count = (st.st_size - sizeof(RecordHeader)) / sizeof(PositionRecord);
+    return true;
+}
+
+/*
+ * Unmaps the file, if one is open.
+ */
+void PositionFile::close() {
+    if (map) munmap(map, mapSize);
+    map = NULL;
+    mapSize = 0;
+    first = NULL;
+    count = 0;
+}
+
+/*
+ * Number of records in the file.
+ */
+size_t PositionFile::size() {
+    return count;
+}
+
+/*
+ * The records, in file order.
+ */
+const PositionRecord *PositionFile::records() {
+    return first;
+}
+
+/*
+ * Fills in a record for a position with no annotations.
+ */
+void recordFromBoard(Board *board, Side side, PositionRecord *record) {
+    memset(record, 0, sizeof(PositionRecord));
+    record->black = board->pieces(BLACK);
+    record->white = board->pieces(WHITE);
+    if (side == WHITE) record->flags = RECORD_WHITE_TO_MOVE;
+}
+
+/*
+ * Sets up a board from a record and returns the side to move.
+ */
+Side recordToBoard(const PositionRecord *record, Board *board) {
+    board->setPieces(record->black, record->white);
+    return (record->flags & RECORD_WHITE_TO_MOVE) ? WHITE : BLACK;
+}
+
+/*
+ * Fills in a record from 64 characters in the format of Board::setBoard():
+ * 'b' for black, 'w' for white and anything else for empty.
+ */
+void recordFromChars(const char data[], Side side, PositionRecord *record) {
+    memset(record, 0, sizeof(PositionRecord));
+    for (int i = 0; i < 64; i++) {
+        uint64_t mask = (uint64_t) 1 << i;
+        if (data[i] == 'b') record->black |= mask;
+        else if (data[i] == 'w') record->white |= mask;
+    }
+    if (side == WHITE) record->flags = RECORD_WHITE_TO_MOVE;
+}
+
+/*
+ * Writes a record's position as 64 characters for Board::setBoard(), with
+ * '-' for the empty squares.
+ */
+void recordToChars(const PositionRecord *record, char data[]) {
+    for (int i = 0; i < 64; i++) {
+        uint64_t mask = (uint64_t) 1 << i;
+        data[i] = (record->black & mask) ? 'b'
+            : (record->white & mask) ? 'w' : '-';
+    }
+}
+
+/*
+ * Reads a position line: 64 square characters as for recordFromChars(),
+ * then whitespace and the side to move ("b"/"Black" or "w"/"White", in
+ * any case), and optionally more whitespace and anything after that.
+ * Returns false if the text doesn't start with one.
+ */
+bool recordFromLine(const char *text, PositionRecord *record) {
+    for (int i = 0; i < 64; i++)
+        if (text[i] == '\0' || isspace((unsigned char) text[i]))
+            return false;
+
+    const char *side = text + 64;
+    if (!isspace((unsigned char) *side)) return false;
+    while (isspace((unsigned char) *side)) side++;
+    int length = 0;
+    while (side[length] && !isspace((unsigned char) side[length])) length++;
+    if ((length == 1 && tolower(side[0]) == 'b')
+        || (length == 5 && !strncasecmp(side, "black", 5)))
+        recordFromChars(text, BLACK, record);
+    else if ((length == 1 && tolower(side[0]) == 'w')
+             || (length == 5 && !strncasecmp(side, "white", 5)))
+        recordFromChars(text, WHITE, record);
+    else
+        return false;
+    return true;
+}
+
+/*
+ * Writes a record's position as a line that recordFromLine() reads back,
+ * without the newline; text needs room for RECORD_LINE_LENGTH characters.
+ */
+void recordToLine(const PositionRecord *record, char *text) {
+    recordToChars(record, text);
+    text[64] = ' ';
+    text[65] = (record->flags & RECORD_WHITE_TO_MOVE) ? 'w' : 'b';
+    text[66] = '\0';
+}
+
+/*
+ * Reads a square in move notation, a column letter from 'a' and a row
+ * number from 1 ("f5" is x = 5, y = 4). Returns -1 if it isn't one.
+ */
+int squareFromText(const char *text) {
+    int x = tolower((unsigned char) text[0]) - 'a';
+    int y = text[0] ? text[1] - '1' : -1;
+    if (x < 0 || x >= 8 || y < 0 || y >= 8) return -1;
+    return x + 8 * y;
+}
+
+/*
+ * Writes a square in move notation, as two characters and a terminator.
+ */
+void squareToText(int sq, char *text) {
+    text[0] = 'a' + sq % 8;
+    text[1] = '1' + sq / 8;
+    text[2] = '\0';
+}
+
+/*
+ * Plays a game given in move notation ("f5d6c3...", upper or lower case,
+ * spaces allowed between moves) from the starting position. Writes a
+ * record for every position a move was played from, with that move; the
+ * first is marked as the start of the game. Passes are left out of the
+ * notation and the records both. If the game was played to the end, every
+ * record also gets the final disc difference.
+ *
+ * Returns the number of records, or -1 if a move can't be read or isn't
+ * legal, or there are more than max of them.
+ */
+int gameFromText(const char *text, PositionRecord *records, int max) {
+    Board board;
+    Side side = BLACK;
+    int count = 0;
+    for (;;) {
+        while (isspace((unsigned char) *text)) text++;
+        if (*text == '\0') break;
+        int sq = squareFromText(text);
+        if (sq < 0 || count >= max) return -1;
+        text += 2;
+
+        if (!board.legalMoves(side)) side = opponent(side);
+        if (!(board.legalMoves(side) & ((uint64_t) 1 << sq))) return -1;
+        recordFromBoard(&board, side, &records[count]);
+        records[count].flags |= RECORD_MOVE
+            | (count == 0 ? RECORD_GAME_START : 0);
+        records[count].move = sq;
+        count++;
+        board.makeMove(sq, side);
+        side = opponent(side);
+    }
+
+    if (board.isDone()) {
+        int diff = board.count(BLACK) - board.count(WHITE);
+        for (int i = 0; i < count; i++) {
+            records[i].flags |= RECORD_SCORE;
+            records[i].score = (records[i].flags & RECORD_WHITE_TO_MOVE)
+                ? -diff : diff;
+        }
+    }
+    return count;
+}
+
+/*
+ * Writes the moves of the game that starts at the first record in move
+ * notation, leaving out passes; text needs room for GAME_TEXT_MAX
+ * characters. Returns the number of records the game takes up, so that
+ * the next game starts after them.
+ */
+int gameToText(const PositionRecord *records, int count, char *text) {
+    int n = 0, length = 0;
+    for (; n < count; n++) {
+        if (n > 0 && (records[n].flags & RECORD_GAME_START)) break;
+        if (!(records[n].flags & RECORD_MOVE)) continue;
+        if (records[n].move >= RECORD_PASS || length + 2 >= GAME_TEXT_MAX)
+            continue;
+        squareToText(records[n].move, text + length);
+        length += 2;
+    }
+    text[length] = '\0';
+    return n;
+}
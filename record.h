@@ -0,0 +1,116 @@
+#ifndef __RECORD_H__
+#define __RECORD_H__
+
+#include <cstdio>
+#include <cstddef>
+#include <stdint.h>
+#include "common.h"
+#include "board.h"
+
+// Position files: a RecordHeader and then PositionRecords back to back,
+// as many as the file has room for.
+#define RECORD_MAGIC 0x5250544f // "OTPR" read as a little-endian word
+#define RECORD_VERSION 1
+
+// Bits of PositionRecord::flags. The annotations are only meaningful when
+// their flag is set.
+#define RECORD_WHITE_TO_MOVE 1 // Else black is to move
+#define RECORD_SCORE 2         // score holds the final disc difference
+#define RECORD_EXACT 4         // score is from perfect play, not one game
+#define RECORD_MOVE 8          // move holds the move played or chosen
+#define RECORD_VALUE 16        // value and depth hold a search result
+#define RECORD_GAME_START 32   // First position of a game
+
+// PositionRecord::move for a pass.
+#define RECORD_PASS 64
+
+// A position as a line of text: 64 squares, a space, the side to move and
+// a terminator.
+#define RECORD_LINE_LENGTH 67
+
+// Longest game in move notation: 60 moves of 2 characters.
+#define GAME_TEXT_MAX 121
+
+/*
+ * File header: magic, version, size of one record and a spare word.
+ */
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+
+/*
+ * One position, stored exactly as it is in the file so that a mapped file
+ * can be read in place. The bitboards are followed by the side to move and
+ * which annotations are present, all in flags. score is the final disc
+ * difference for the side to move, move a square (x + 8*y) or RECORD_PASS,
+ * and value the score of a search to the given depth for the side to move.
+ * A game is a run of records from one with RECORD_GAME_START, each with
+ * the move played from it.
+ */
+struct PositionRecord {
+    uint64_t black;
+    uint64_t white;
+    uint8_t flags;
+    int8_t score;
+    uint8_t move;
+    uint8_t depth;
+    int32_t value;
+};
+
+/*
+ * Appends records to a position file through a stdio buffer, creating the
+ * file if needed, so a writer can stream any number of positions out.
+ */
+class PositionWriter {
+
+public:
+    PositionWriter();
+    ~PositionWriter();
+
+    bool open(const char *filename);
+    bool write(const PositionRecord *record);
+    bool close();
+
+private:
+    FILE *file;
+};
+
+/*
+ * Read-only position file. Like the opening book, the file is mapped into
+ * memory and its records are used where they lie, so opening costs next to
+ * nothing and only the pages being read take up memory.
+ */
+class PositionFile {
+
+public:
+    PositionFile();
+    ~PositionFile();
+
+    bool open(const char *filename);
+    void close();
+    size_t size();
+    const PositionRecord *records();
+
+private:
+    void *map;
+    size_t mapSize;
+    const PositionRecord *first;
+    size_t count;
+};
+
+void recordFromBoard(Board *board, Side side, PositionRecord *record);
+Side recordToBoard(const PositionRecord *record, Board *board);
+void recordFromChars(const char data[], Side side, PositionRecord *record);
+void recordToChars(const PositionRecord *record, char data[]);
+bool recordFromLine(const char *text, PositionRecord *record);
+void recordToLine(const PositionRecord *record, char *text);
+
+int squareFromText(const char *text);
+void squareToText(int sq, char *text);
+int gameFromText(const char *text, PositionRecord *records, int max);
+int gameToText(const PositionRecord *records, int count, char *text);
+
+#endif
@@ -0,0 +1,607 @@
+#include <cmath>
+#include <cstring>
+#include "search.h"
+
+/*
+ * Set up a search with the default options. The same Search can be run on
+ * any number of positions.
+ */
+Search::Search() {
+    discCountEval = false;
+    verbose = false;
+    nodes = 0;
+    clock = NULL;
+    stopped = false;
+    tt = NULL;
+    exactEmpties = DEFAULT_EXACT_EMPTIES;
+    wldEmpties = DEFAULT_WLD_EMPTIES;
+    probCut = DEFAULT_PROBCUT_THRESHOLD;
+    helperId = 0;
+    helperSide = BLACK;
+    helperMaxDepth = 0;
+    memset(history, 0, sizeof(history));
+    memset(&stats, 0, sizeof(stats));
+}
+
+/*
+ * Destructor for the search.
+ */
+Search::~Search() {
+    setThreads(1);
+}
+
+/*
+ * Sets how many threads run() searches with. With more than one, helper
+ * searches run the same iterative deepening alongside the main one and
+ * share its transposition table (Lazy SMP); the main search alone decides
+ * the move. One thread gives a fully deterministic search.
+ */
+void Search::setThreads(int n) {
+    if (n < 1) n = 1;
+    if (n > MAX_THREADS) n = MAX_THREADS;
+    while ((int) helpers.size() > n - 1) {
+        delete helpers.back();
+        helpers.pop_back();
+    }
+    while ((int) helpers.size() < n - 1) {
+        Search *helper = new Search();
+        helper->helperId = helpers.size() + 1;
+        helpers.push_back(helper);
+    }
+}
+
+/*
+ * Number of threads run() searches with.
+ */
+int Search::threads() {
+    return helpers.size() + 1;
+}
+
+/*
+ * Move ordering statistics for the last call to run(), main thread only.
+ */
+OrderingStats *Search::orderingStats() {
+    return &stats;
+}
+
+/*
+ * Instrumentation of the last call to run(), main thread only; see
+ * writeStatsLine() and writeTrace() for all threads.
+ */
+SearchStats *Search::searchStats() {
+    return &instrument;
+}
+
+/*
+ * Searches the position with the given side to move by iterative deepening,
+ * one ply at a time up to maxDepth plies. Every completed iteration leaves
+ * its best move and principal variation in the result, so the move from
+ * the last iteration is always ready to play.
+ *
+ * If a timer is given, no new iteration is started once it says there is
+ * no more time, and a running iteration is abandoned at its hard deadline.
+ * The first iteration always completes so that there is a move to play.
+ *
+ * Near the end of the game the position is instead solved by the endgame
+ * solver, after a shallow search that provides a move in case the solver
+ * does not finish in time.
+ */
+SearchResult Search::run(Board *board, Side side, int maxDepth,
+                         TimeManager *timer) {
+    SearchResult result;
+    result.move = -1;
+    result.score = 0;
+    result.depth = 0;
+    result.pvLength = 0;
+    nodes = 0;
+    stopped = false;
+    clock = NULL;
+    if (tt) tt->newSearch();
+    long startTime = nowMs();
+    startOrdering();
+    startStats();
+
+    // Search on a private copy that moves are made and unmade on in place.
+    Board root = *board;
+    eval.setBoard(&root);
+    MoveList *rootMoves = &moveStack[0];
+    rootMoves->count = 0;
+    for (uint64_t m = root.legalMoves(side); m; m &= m - 1)
+        rootMoves->moves[rootMoves->count++] = firstSquare(m);
+
+    // Nothing to search if we have to pass.
+    if (rootMoves->count == 0) {
+        result.nodes = 0;
+        result.ms = 0;
+        instrument.endUs = nowUs();
+        return result;
+    }
+    result.move = rootMoves->moves[0];
+
+    // Passes don't use up depth, so searching as many plies as there are
+    // empty squares already reaches the end of every line.
+    int empties = 64 - root.count(BLACK) - root.count(WHITE);
+    if (maxDepth > empties) maxDepth = empties;
+
+    bool solving = (empties <= exactEmpties || empties <= wldEmpties);
+    if (solving && maxDepth > ENDGAME_FALLBACK_DEPTH)
+        maxDepth = ENDGAME_FALLBACK_DEPTH;
+
+    for (unsigned int i = 0; i < helpers.size(); i++) {
+        Search *helper = helpers[i];
+        helper->tt = tt;
+        helper->discCountEval = discCountEval;
+        helper->probCut = probCut;
+        helper->helperBoard = root;
+        helper->helperSide = side;
+        helper->helperMaxDepth = maxDepth;
+        helper->stopped = false;
+        helper->nodes = 0;
+        pthread_create(&helper->thread, NULL, helperMain, helper);
+    }
+
+    for (int depth = 1; depth <= maxDepth; depth++) {
+        if (depth > 1 && timer) {
+            if (!timer->moreTime()) break;
+            clock = timer;
+        }
+
+        uint64_t startNodes = nodes;
+        long iterationStart = nowUs();
+        int score = searchRoot(&root, side, depth, rootMoves);
+        iterationStats(depth, startNodes, iterationStart, score,
+                       pvTable[0][0]);
+        if (isStopped()) break;
+
+        bool changed = (pvTable[0][0] != result.move);
+        if (timer && depth > 1) timer->iterationDone(changed);
+
+        result.move = pvTable[0][0];
+        result.score = score;
+        result.depth = depth;
+        result.pvLength = pvLength[0];
+        for (int i = 0; i < pvLength[0]; i++)
+            result.pv[i] = pvTable[0][i];
+
+        if (verbose) {
+            std::cerr << "depth " << depth << " score " << score
+                      << " nodes " << nodes;
+            if (timer) std::cerr << " time " << timer->elapsed();
+            std::cerr << " pv";
+            for (int i = 0; i < result.pvLength; i++) {
+                if (result.pv[i] < 0) std::cerr << " pass";
+                else std::cerr << " (" << result.pv[i] % 8 << ", "
+                               << result.pv[i] / 8 << ")";
+            }
+            std::cerr << std::endl;
+        }
+    }
+
+    // The main search is done, so the helpers are too.
+    result.nodes = nodes;
+    for (unsigned int i = 0; i < helpers.size(); i++) {
+        helpers[i]->stopped = true;
+        pthread_join(helpers[i]->thread, NULL);
+        result.nodes += helpers[i]->nodes;
+    }
+
+    if (solving) {
+        bool wld = (empties > exactEmpties);
+        instrument.endgameStartUs = nowUs();
+        endgame.tt = tt;
+        EndgameResult solution = endgame.solve(&root, side, wld, timer);
+        instrument.endgameEndUs = nowUs();
+        instrument.endgameNodes = solution.nodes;
+        result.nodes += solution.nodes;
+        // A proven win/loss/draw search can't tell losing moves apart, so
+        // a lost position keeps the move the search liked best.
+        if (solution.solved && solution.move >= 0
+            && (!wld || solution.score >= 0)) {
+            result.move = solution.move;
+            result.score = (solution.score > 0) ? WIN_SCORE + solution.score
+                : (solution.score < 0) ? -WIN_SCORE + solution.score : 0;
+            result.depth = empties;
+            result.pv[0] = solution.move;
+            result.pvLength = 1;
+        }
+        if (verbose) {
+            std::cerr << (wld ? "wld" : "exact") << " solve with " << empties
+                      << " empties: ";
+            if (solution.solved) std::cerr << "score " << solution.score;
+            else std::cerr << "out of time";
+            std::cerr << " nodes " << solution.nodes << std::endl;
+        }
+    }
+    result.ms = (int) (nowMs() - startTime);
+    instrument.endUs = nowUs();
+
+    if (verbose) {
+        for (int d = 1; d < MAX_PLY; d++) {
+            if (stats.cutNodes[d] == 0) continue;
+            std::cerr << "ordering depth " << d << ": " << stats.cutNodes[d]
+                      << " cut nodes, first move cut "
+                      << 100 * stats.firstMoveCuts[d] / stats.cutNodes[d]
+                      << "%" << std::endl;
+        }
+        std::cerr << "nodes " << result.nodes << " time " << result.ms
+                  << " nps " << result.nodes * 1000 / (result.ms + 1)
+                  << " threads " << threads() << std::endl;
+    }
+    return result;
+}
+
+/*
+ * Thread entry point for a helper search.
+ */
+void *Search::helperMain(void *arg) {
+    ((Search *) arg)->helperLoop();
+    return NULL;
+}
+
+/*
+ * Iterative deepening for a helper thread, run until the main search sets
+ * stopped. Half of the helpers start one ply deeper than the main search
+ * so that the threads spread over different depths; what they find only
+ * reaches the main search through the transposition table.
+ */
+void Search::helperLoop() {
+    Board root = helperBoard;
+    eval.setBoard(&root);
+    startOrdering();
+    startStats();
+    MoveList *rootMoves = &moveStack[0];
+    rootMoves->count = 0;
+    for (uint64_t m = root.legalMoves(helperSide); m; m &= m - 1)
+        rootMoves->moves[rootMoves->count++] = firstSquare(m);
+
+    for (int depth = 1 + (helperId & 1);
+         depth <= helperMaxDepth && !isStopped(); depth++) {
+        uint64_t startNodes = nodes;
+        long iterationStart = nowUs();
+        int score = searchRoot(&root, helperSide, depth, rootMoves);
+        iterationStats(depth, startNodes, iterationStart, score,
+                       pvTable[0][0]);
+    }
+    instrument.endUs = nowUs();
+}
+
+/*
+ * Searches every root move to the given depth with a principal variation
+ * search, then moves the best one to the front of the list so the next
+ * iteration tries it first. Returns the score of the best move.
+ */
+int Search::searchRoot(Board *board, Side side, int depth, MoveList *list) {
+    int *moves = list->moves;
+    int alpha = -INF_SCORE;
+    int beta = INF_SCORE;
+    int best = 0;
+    nodes++;
+    STAT(instrument.plyNodes[0]++);
+
+    for (int i = 0; i < list->count; i++) {
+        int sq = moves[i];
+        uint64_t flipped = board->makeMove(sq, side);
+        eval.update(sq, flipped, side);
+        int score;
+        if (i == 0) {
+            score = -negamax(board, opponent(side), depth - 1, -beta, -alpha,
+                             1, false);
+        }
+        else {
+            // Prove the move is no better than the current best with a null
+            // window, and only search it fully if that fails.
+            score = -negamax(board, opponent(side), depth - 1, -alpha - 1,
+                             -alpha, 1, false);
+            if (score > alpha) {
+                score = -negamax(board, opponent(side), depth - 1, -beta,
+                                 -alpha, 1, false);
+            }
+        }
+        board->undoMove(sq, flipped, side);
+        eval.undo(sq, flipped, side);
+
+        if (score > alpha || i == 0) {
+            alpha = score;
+            best = i;
+            pvTable[0][0] = sq;
+            for (int j = 1; j < pvLength[1]; j++)
+                pvTable[0][j] = pvTable[1][j];
+            pvLength[0] = pvLength[1];
+        }
+    }
+
+    if (tt && !isStopped())
+        tt->store(board->hashKey(side), depth, BOUND_EXACT, alpha, moves[best]);
+
+    // Keep the rest of the list in order behind the new best move.
+    int bestMove = moves[best];
+    for (int i = best; i > 0; i--)
+        moves[i] = moves[i - 1];
+    moves[0] = bestMove;
+
+    return alpha;
+}
+
+/*
+ * Negamax alpha-beta search with principal variation search: after the
+ * first move, every move is searched with a null window and re-searched
+ * only if it turns out to be better. Returns the score for the side to
+ * move; passing does not use up depth.
+ */
+int Search::negamax(Board *board, Side side, int depth, int alpha, int beta,
+                    int ply, bool passed) {
+    nodes++;
+    STAT(instrument.plyNodes[ply]++);
+    pvLength[ply] = ply;
+
+    // Look at the clock every so often, and unwind as soon as time is up.
+    if (clock && (nodes & (TIME_CHECK_NODES - 1)) == 0 && clock->outOfTime())
+        stopped.store(true, std::memory_order_relaxed);
+    if (isStopped()) return 0;
+
+    if (depth == 0 || ply >= MAX_PLY - 1) return evaluate(board, side);
+
+    // A stored result that is deep enough can settle a null-window node
+    // outright; failing that, its move is the first one to try.
+    uint64_t key = board->hashKey(side);
+    int ttMove = -1;
+    TTEntry entry;
+    STAT(if (tt) instrument.ttProbes++);
+    if (tt && tt->probe(key, &entry)) {
+        STAT(instrument.ttHits++);
+        ttMove = entry.move;
+        if (entry.depth >= depth && beta - alpha == 1
+            && (entry.bound == BOUND_EXACT
+                || (entry.bound == BOUND_LOWER && entry.score >= beta)
+                || (entry.bound == BOUND_UPPER && entry.score <= alpha))) {
+            STAT(instrument.ttCutoffs++);
+            return entry.score;
+        }
+    }
+
+    // Multi-ProbCut: a shallow search that is far enough outside the
+    // window predicts that the full-depth one would be too.
+    if (probCut > 0 && depth >= PROBCUT_MIN_DEPTH && beta - alpha == 1
+        && !discCountEval && alpha > -WIN_SCORE && beta < WIN_SCORE) {
+        int score;
+        if (tryProbCut(board, side, depth, alpha, beta, ply, &score))
+            return score;
+        pvLength[ply] = ply;
+        if (isStopped()) return 0;
+    }
+
+    uint64_t moves = board->legalMoves(side);
+    if (moves == 0) {
+        // Neither side can move, so the game is over.
+        if (passed) return finalScore(board, side);
+
+        int score = -negamax(board, opponent(side), depth, -beta, -alpha,
+                             ply + 1, true);
+        pvTable[ply][ply] = -1;
+        for (int j = ply + 1; j < pvLength[ply + 1]; j++)
+            pvTable[ply][j] = pvTable[ply + 1][j];
+        pvLength[ply] = pvLength[ply + 1];
+        return score;
+    }
+
+    MoveList *list = &moveStack[ply];
+    orderMoves(board, side, moves, ttMove, depth, ply, list);
+
+    int alphaOrig = alpha;
+    int best = -INF_SCORE;
+    int bestMove = -1;
+    bool first = true;
+    for (int i = 0; i < list->count; i++) {
+        int sq = list->moves[i];
+        uint64_t flipped = board->makeMove(sq, side);
+        eval.update(sq, flipped, side);
+        int score;
+        if (first) {
+            score = -negamax(board, opponent(side), depth - 1, -beta, -alpha,
+                             ply + 1, false);
+        }
+        else {
+            score = -negamax(board, opponent(side), depth - 1, -alpha - 1,
+                             -alpha, ply + 1, false);
+            if (score > alpha && score < beta) {
+                score = -negamax(board, opponent(side), depth - 1, -beta,
+                                 -alpha, ply + 1, false);
+            }
+        }
+        board->undoMove(sq, flipped, side);
+        eval.undo(sq, flipped, side);
+        first = false;
+
+        if (score > best) {
+            best = score;
+            bestMove = sq;
+            if (score > alpha) {
+                alpha = score;
+                pvTable[ply][ply] = sq;
+                for (int j = ply + 1; j < pvLength[ply + 1]; j++)
+                    pvTable[ply][j] = pvTable[ply + 1][j];
+                pvLength[ply] = pvLength[ply + 1];
+                if (alpha >= beta) {
+                    recordCutoff(side, sq, depth, ply, i == 0);
+                    break;
+                }
+            }
+        }
+    }
+
+    if (tt && !isStopped()) {
+        int bound = (best >= beta) ? BOUND_LOWER
+            : (best > alphaOrig) ? BOUND_EXACT : BOUND_UPPER;
+        tt->store(key, depth, bound, best, bestMove);
+    }
+    return best;
+}
+
+/*
+ * Tries the Multi-ProbCut checks for this phase and depth, cheapest first.
+ * Each one estimates the depth-"depth" score from a shallow search as
+ * a * shallow + b with error sigma, and searches the shallow depth with a
+ * null window at the bound beyond which the estimate is probCut sigmas
+ * above beta or below alpha. Returns true with the fail-hard score in
+ * *score if one of them cuts.
+ */
+bool Search::tryProbCut(Board *board, Side side, int depth, int alpha,
+                        int beta, int ply, int *score) {
+    int phase = Eval::phase(board);
+    for (int i = 0; i < PROBCUT_CHECKS; i++) {
+        ProbCutCheck *check = ProbCut::check(phase, depth, i);
+        if (!check) continue;
+        STAT(instrument.probCutTries++);
+        double margin = probCut * check->sigma;
+
+        int bound = (int) ceil((beta + margin - check->b) / check->a);
+        if (bound < WIN_SCORE) {
+            int value = negamax(board, side, check->shallow, bound - 1, bound,
+                                ply, false);
+            if (isStopped()) return false;
+            if (value >= bound) {
+                STAT(instrument.probCutCuts++);
+                *score = beta;
+                return true;
+            }
+        }
+
+        bound = (int) floor((alpha - margin - check->b) / check->a);
+        if (bound > -WIN_SCORE) {
+            int value = negamax(board, side, check->shallow, bound, bound + 1,
+                                ply, false);
+            if (isStopped()) return false;
+            if (value <= bound) {
+                STAT(instrument.probCutCuts++);
+                *score = alpha;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/*
+ * Clears the killer moves and statistics and ages the history scores at
+ * the start of a search.
+ */
+void Search::startOrdering() {
+    for (int ply = 0; ply < MAX_PLY; ply++)
+        killers[ply][0] = killers[ply][1] = -1;
+    for (int sq = 0; sq < 64; sq++) {
+        history[WHITE][sq] /= 2;
+        history[BLACK][sq] /= 2;
+    }
+    memset(&stats, 0, sizeof(stats));
+}
+
+/*
+ * Puts the legal moves into the list in the order they should be searched
+ * in. The transposition table move comes first,
+ * then the killer moves for this ply, and then the rest by history score
+ * with the static square value as tie-break. Far enough from the leaves,
+ * moves that leave the opponent fewer replies are also preferred.
+ */
+void Search::orderMoves(Board *board, Side side, uint64_t moves, int ttMove,
+                        int depth, int ply, MoveList *list) {
+    int *order = list->moves;
+    int *keys = list->keys;
+    int numMoves = 0;
+    bool fastestFirst = (depth >= FASTEST_FIRST_DEPTH);
+    uint64_t own = board->pieces(side);
+    uint64_t opp = board->pieces(opponent(side));
+
+    for (; moves; moves &= moves - 1) {
+        int sq = firstSquare(moves);
+        int key;
+        if (sq == ttMove) key = 1 << 30;
+        else if (sq == killers[ply][0]) key = (1 << 30) - 1;
+        else if (sq == killers[ply][1]) key = (1 << 30) - 2;
+        else {
+            key = history[side][sq] * 16 + SQUARE_WEIGHTS[sq];
+            if (fastestFirst) {
+                uint64_t flipped = flipMask(own, opp, sq);
+                uint64_t replies = legalMoveMask(opp & ~flipped,
+                    own | flipped | ((uint64_t) 1 << sq));
+                key -= popCount(replies) * ORDER_MOBILITY_WEIGHT;
+            }
+        }
+
+        int i = numMoves++;
+        for (; i > 0 && keys[i - 1] < key; i--) {
+            order[i] = order[i - 1];
+            keys[i] = keys[i - 1];
+        }
+        order[i] = sq;
+        keys[i] = key;
+    }
+    list->count = numMoves;
+}
+
+/*
+ * Clears the instrumentation for a new run.
+ */
+void Search::startStats() {
+    memset(&instrument, 0, sizeof(instrument));
+    instrument.startUs = nowUs();
+}
+
+/*
+ * Records an iteration that started at startUs with startNodes nodes
+ * searched so far.
+ */
+void Search::iterationStats(int depth, uint64_t startNodes, long startUs,
+                            int score, int move) {
+    if (instrument.numIterations >= MAX_PLY) return;
+    IterationStats *it = &instrument.iterations[instrument.numIterations++];
+    it->depth = depth;
+    it->score = score;
+    it->move = move;
+    it->completed = !isStopped();
+    it->nodes = nodes - startNodes;
+    it->startUs = startUs;
+    it->endUs = nowUs();
+}
+
+/*
+ * Remembers a move that caused a beta cutoff as a killer for its ply and
+ * in the history table, and counts the cutoff in the statistics.
+ */
+void Search::recordCutoff(Side side, int sq, int depth, int ply, bool first) {
+    if (killers[ply][0] != sq) {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = sq;
+    }
+
+    history[side][sq] += depth * depth;
+    if (history[side][sq] > HISTORY_MAX) {
+        for (int i = 0; i < 64; i++) {
+            history[WHITE][i] /= 2;
+            history[BLACK][i] /= 2;
+        }
+    }
+
+    stats.cutNodes[depth]++;
+    if (first) stats.firstMoveCuts[depth]++;
+    STAT(instrument.plyCutoffs[ply]++);
+}
+
+/*
+ * Heuristic score of a position for the side to move.
+ */
+int Search::evaluate(Board *board, Side side) {
+    STAT(instrument.evalCalls++);
+    if (discCountEval)
+        return board->count(side) - board->count(opponent(side));
+    return eval.score(board, side);
+}
+
+/*
+ * Exact score of a finished game for the side to move.
+ */
+int Search::finalScore(Board *board, Side side) {
+    int diff = board->count(side) - board->count(opponent(side));
+    if (diff > 0) return WIN_SCORE + diff;
+    if (diff < 0) return -WIN_SCORE + diff;
+    return 0;
+}
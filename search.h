@@ -0,0 +1,212 @@
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+#include <cstdio>
+#include <iostream>
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <pthread.h>
+#include "common.h"
+#include "board.h"
+#include "timeman.h"
+#include "tt.h"
+#include "endgame.h"
+#include "eval.h"
+#include "probcut.h"
+using namespace std;
+
+// Longest line the search can follow, counting passes.
+#define MAX_PLY 128
+
+// Most threads setThreads() will start.
+#define MAX_THREADS 256
+
+// With this many empties or fewer, run() hands the position to the endgame
+// solver: exactly, or for a win/loss/draw result only.
+#define DEFAULT_EXACT_EMPTIES 16
+#define DEFAULT_WLD_EMPTIES 20
+
+// Depth of the quick search that provides a move in case the endgame
+// solver runs out of time.
+#define ENDGAME_FALLBACK_DEPTH 6
+
+// At this remaining depth and above, moves are also ordered by how few
+// replies they leave the opponent (fastest-first).
+#define FASTEST_FIRST_DEPTH 5
+
+// Ordering key given up for each reply a move leaves the opponent.
+#define ORDER_MOBILITY_WEIGHT 64
+
+// History scores are halved once one of them passes this.
+#define HISTORY_MAX (1 << 20)
+
+// Scores at or beyond WIN_SCORE are finished games; the disc difference is
+// added on top so that bigger wins are preferred.
+#define WIN_SCORE 10000
+#define INF_SCORE 30000
+
+// Most moves a list can hold; no position has more legal moves than there
+// are empty squares.
+#define MAX_MOVES 64
+
+/*
+ * A fixed-capacity list of moves (x + 8*y), each with the key it was
+ * ordered by.
+ */
+struct MoveList {
+    int moves[MAX_MOVES];
+    int keys[MAX_MOVES];
+    int count;
+};
+
+struct SearchResult {
+    int move;            // Best square (x + 8*y), or -1 to pass
+    int score;           // Score of the best move for the side to move
+    int depth;           // Deepest iteration that completed
+    uint64_t nodes;      // Nodes visited over all iterations and threads
+    int ms;              // Milliseconds the search took
+    int pv[MAX_PLY];     // Principal variation, -1 entries are passes
+    int pvLength;
+};
+
+/*
+ * Define SEARCH_STATS (make STATS=1) to count nodes per ply, cutoffs,
+ * transposition table probes, evaluations and ProbCut tries in
+ * SearchStats. Without it STAT() compiles to nothing.
+ */
+#ifdef SEARCH_STATS
+#define STAT(x) do { x; } while (0)
+#else
+#define STAT(x) do { } while (0)
+#endif
+
+/*
+ * One iteration of iterative deepening. Times are nowUs() readings.
+ */
+struct IterationStats {
+    int depth;
+    int score;
+    int move;            // Best move after the iteration, -1 for a pass
+    bool completed;      // False if time ran out during it
+    uint64_t nodes;      // Nodes of this iteration alone
+    long startUs;
+    long endUs;
+};
+
+/*
+ * What one thread did in the last call to run(). The iteration records
+ * are always kept; the counters only with SEARCH_STATS.
+ */
+struct SearchStats {
+    long startUs;
+    long endUs;
+    int numIterations;
+    IterationStats iterations[MAX_PLY];
+    long endgameStartUs; // Both 0 if the endgame solver didn't run
+    long endgameEndUs;
+    uint64_t endgameNodes;
+
+    uint64_t plyNodes[MAX_PLY];
+    uint64_t plyCutoffs[MAX_PLY];
+    uint64_t ttProbes;
+    uint64_t ttHits;
+    uint64_t ttCutoffs;  // Nodes settled by a stored score alone
+    uint64_t evalCalls;
+    uint64_t probCutTries;
+    uint64_t probCutCuts;
+};
+
+/*
+ * Move ordering quality, per remaining depth: how many nodes had a beta
+ * cutoff, and in how many of those the first move tried caused it.
+ */
+struct OrderingStats {
+    uint64_t cutNodes[MAX_PLY];
+    uint64_t firstMoveCuts[MAX_PLY];
+};
+
+class Search {
+
+public:
+    Search();
+    ~Search();
+
+    SearchResult run(Board *board, Side side, int maxDepth,
+                     TimeManager *timer = NULL);
+    void setThreads(int n);
+    int threads();
+    OrderingStats *orderingStats();
+    SearchStats *searchStats();
+    void writeStatsLine(FILE *out);
+    void writeTrace(FILE *out);
+
+    // Score leaves by disc difference instead of the pattern evaluation.
+    bool discCountEval;
+    // Print one line per completed iteration to cerr.
+    bool verbose;
+    // Solve positions with at most this many empties exactly, or with at
+    // most wldEmpties for win/loss/draw. 0 turns the solver off.
+    int exactEmpties;
+    int wldEmpties;
+    // Multi-ProbCut threshold in standard deviations: the higher, the less
+    // is pruned. 0 searches every move to full depth.
+    double probCut;
+    // Table of earlier results, kept across iterations and moves; the
+    // endgame solver keeps its results in it too. May be NULL to search
+    // without one.
+    TranspositionTable *tt;
+
+private:
+    uint64_t nodes;
+    TimeManager *clock; // Checked while searching, NULL if not timed
+    // Set when time is up or the search is over; the main search also sets
+    // it for each helper, from its own thread.
+    std::atomic<bool> stopped;
+
+    // Lazy SMP: helper searches run the same iterations on their own
+    // threads, sharing only the transposition table.
+    std::vector<Search *> helpers;
+    int helperId;       // 0 for the main search
+    Board helperBoard;
+    Side helperSide;
+    int helperMaxDepth;
+    pthread_t thread;   // The thread a helper runs on
+
+    static void *helperMain(void *arg);
+    void helperLoop();
+    // Polled at every node; a relaxed load is enough, since nothing else is
+    // read on the strength of it.
+    bool isStopped() const { return stopped.load(std::memory_order_relaxed); }
+    int pvTable[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
+    Endgame endgame;
+
+    // Move ordering: two killer moves per ply and a history score per side
+    // and square, both from earlier beta cutoffs.
+    int killers[MAX_PLY][2];
+    int history[2][64];
+    OrderingStats stats;
+    SearchStats instrument;
+    // One move list per ply, so that searching allocates nothing; the root
+    // moves are moveStack[0].
+    MoveList moveStack[MAX_PLY];
+    Eval eval; // Pattern indices, kept in step with the searched board
+
+    int negamax(Board *board, Side side, int depth, int alpha, int beta,
+                int ply, bool passed);
+    bool tryProbCut(Board *board, Side side, int depth, int alpha,
+                    int beta, int ply, int *score);
+    int evaluate(Board *board, Side side);
+    int finalScore(Board *board, Side side);
+    int searchRoot(Board *board, Side side, int depth, MoveList *list);
+    void orderMoves(Board *board, Side side, uint64_t moves, int ttMove,
+                    int depth, int ply, MoveList *list);
+    void startOrdering();
+    void startStats();
+    void iterationStats(int depth, uint64_t startNodes, long startUs,
+                        int score, int move);
+    void recordCutoff(Side side, int sq, int depth, int ply, bool first);
+};
+
+#endif
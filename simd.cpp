@@ -0,0 +1,250 @@
+#include "bitboard.h"
+#include "simd.h"
+
+#if defined(__x86_64__)
+#define HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+uint64_t (*legalMovesKernel)(uint64_t own, uint64_t opp) = legalMovesScalar;
+uint64_t (*flipsKernel)(uint64_t own, uint64_t opp, int sq) = flipsScalar;
+
+static SimdLevel currentLevel = SIMD_SCALAR;
+
+/*
+ * Picks the best kernels once at startup.
+ */
+static struct SimdInit {
+    SimdInit() {
+        setSimdLevel(bestSimdLevel());
+    }
+} simdInit;
+
+/*
+ * The scalar kernels: the shift and ray lookup code from bitboard.h.
+ */
+uint64_t legalMovesScalar(uint64_t own, uint64_t opp) {
+    return legalMoveMaskScalar(own, opp);
+}
+
+uint64_t flipsScalar(uint64_t own, uint64_t opp, int sq) {
+    return flipMaskScalar(own, opp, sq);
+}
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * SSE2 move generation. SSE2 can only shift both lanes of a vector the
+ * same way, so the second lane holds the board mirrored top to bottom: a
+ * left shift there is a shift in the opposite vertical direction on the
+ * real board. One vector then covers +y and -y, or one diagonal each way.
+ * Horizontal captures still take a left and a right shift. There is no
+ * SSE2 flip kernel: the same scheme came out slower than the scalar ray
+ * lookups.
+ */
+
+// The Kogge-Stone fill of movesLeft() in both lanes, for the run of "pro"
+// discs starting next to "from"; S has to be a constant.
+#define SSE2_FILL(x, from, pro, S, SHIFT) do { \
+        __m128i p = (pro); \
+        x = _mm_and_si128(SHIFT(from, S), p); \
+        x = _mm_or_si128(x, _mm_and_si128(p, SHIFT(x, S))); \
+        p = _mm_and_si128(p, SHIFT(p, S)); \
+        x = _mm_or_si128(x, _mm_and_si128(p, SHIFT(x, 2 * S))); \
+        p = _mm_and_si128(p, SHIFT(p, 2 * S)); \
+        x = _mm_or_si128(x, _mm_and_si128(p, SHIFT(x, 4 * S))); \
+    } while (0)
+
+/*
+ * Makes the vector of a bitboard and its vertical mirror.
+ */
+static inline __m128i mirrorPair(uint64_t b) {
+    return _mm_set_epi64x(__builtin_bswap64(b), b);
+}
+
+/*
+ * Combines the two lanes of a mirrored pair back into one bitboard.
+ */
+static inline uint64_t unmirror(__m128i v) {
+    uint64_t low = _mm_cvtsi128_si64(v);
+    uint64_t high = _mm_cvtsi128_si64(_mm_unpackhi_epi64(v, v));
+    return low | __builtin_bswap64(high);
+}
+
+uint64_t legalMovesSSE2(uint64_t own, uint64_t opp) {
+    __m128i P = mirrorPair(own);
+    __m128i O = mirrorPair(opp);
+    __m128i inner = _mm_and_si128(O, _mm_set1_epi64x(INNER_FILES));
+    __m128i x, moves;
+
+    SSE2_FILL(x, P, O, 8, _mm_slli_epi64);        // +y and -y
+    moves = _mm_slli_epi64(x, 8);
+    SSE2_FILL(x, P, inner, 9, _mm_slli_epi64);    // +x +y and +x -y
+    moves = _mm_or_si128(moves, _mm_slli_epi64(x, 9));
+    SSE2_FILL(x, P, inner, 7, _mm_slli_epi64);    // -x +y and -x -y
+    moves = _mm_or_si128(moves, _mm_slli_epi64(x, 7));
+    SSE2_FILL(x, P, inner, 1, _mm_slli_epi64);    // +x
+    moves = _mm_or_si128(moves, _mm_slli_epi64(x, 1));
+    SSE2_FILL(x, P, inner, 1, _mm_srli_epi64);    // -x
+    moves = _mm_or_si128(moves, _mm_srli_epi64(x, 1));
+
+    return unmirror(moves) & ~(own | opp);
+}
+
+/*
+ * AVX2 kernels. Each 64-bit lane takes one of the shifts 1, 8, 9 and 7,
+ * so one vector left shift and one right shift cover all 8 directions.
+ */
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+/*
+ * ORs the four lanes together.
+ */
+AVX2_TARGET static inline uint64_t orLanes(__m256i v) {
+    __m128i half = _mm_or_si128(_mm256_castsi256_si128(v),
+                                _mm256_extracti128_si256(v, 1));
+    return _mm_cvtsi128_si64(_mm_or_si128(half,
+                                          _mm_unpackhi_epi64(half, half)));
+}
+
+/*
+ * Opponent discs each direction's run may pass through: only the inner
+ * files, except vertically.
+ */
+AVX2_TARGET static inline __m256i passable(uint64_t opp) {
+    return _mm256_and_si256(_mm256_set1_epi64x(opp),
+        _mm256_set_epi64x(INNER_FILES, INNER_FILES, -1, INNER_FILES));
+}
+
+AVX2_TARGET uint64_t legalMovesAVX2(uint64_t own, uint64_t opp) {
+    const __m256i s1 = _mm256_set_epi64x(7, 9, 8, 1);
+    const __m256i s2 = _mm256_add_epi64(s1, s1);
+    __m256i P = _mm256_set1_epi64x(own);
+    __m256i O = passable(opp);
+
+    // Runs of at least one disc, extended to at most 6 by doubling steps.
+    __m256i left = _mm256_and_si256(O, _mm256_sllv_epi64(P, s1));
+    __m256i right = _mm256_and_si256(O, _mm256_srlv_epi64(P, s1));
+    left = _mm256_or_si256(left,
+        _mm256_and_si256(O, _mm256_sllv_epi64(left, s1)));
+    right = _mm256_or_si256(right,
+        _mm256_and_si256(O, _mm256_srlv_epi64(right, s1)));
+    __m256i pairLeft = _mm256_and_si256(O, _mm256_sllv_epi64(O, s1));
+    __m256i pairRight = _mm256_srlv_epi64(pairLeft, s1);
+    for (int i = 0; i < 2; i++) {
+        left = _mm256_or_si256(left,
+            _mm256_and_si256(pairLeft, _mm256_sllv_epi64(left, s2)));
+        right = _mm256_or_si256(right,
+            _mm256_and_si256(pairRight, _mm256_srlv_epi64(right, s2)));
+    }
+
+    __m256i moves = _mm256_or_si256(_mm256_sllv_epi64(left, s1),
+                                    _mm256_srlv_epi64(right, s1));
+    return orLanes(moves) & ~(own | opp);
+}
+
+AVX2_TARGET uint64_t flipsAVX2(uint64_t own, uint64_t opp, int sq) {
+    const __m256i s1 = _mm256_set_epi64x(7, 9, 8, 1);
+    const __m256i s2 = _mm256_add_epi64(s1, s1);
+    const __m256i s4 = _mm256_add_epi64(s2, s2);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i P = _mm256_set1_epi64x(own);
+    __m256i O = passable(opp);
+    __m256i M = _mm256_set1_epi64x((uint64_t) 1 << sq);
+
+    __m256i pro = O;
+    __m256i left = _mm256_and_si256(pro, _mm256_sllv_epi64(M, s1));
+    left = _mm256_or_si256(left,
+        _mm256_and_si256(pro, _mm256_sllv_epi64(left, s1)));
+    pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, s1));
+    left = _mm256_or_si256(left,
+        _mm256_and_si256(pro, _mm256_sllv_epi64(left, s2)));
+    pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, s2));
+    left = _mm256_or_si256(left,
+        _mm256_and_si256(pro, _mm256_sllv_epi64(left, s4)));
+    __m256i open = _mm256_cmpeq_epi64(
+        _mm256_and_si256(_mm256_sllv_epi64(left, s1), P), zero);
+    __m256i flips = _mm256_andnot_si256(open, left);
+
+    pro = O;
+    __m256i right = _mm256_and_si256(pro, _mm256_srlv_epi64(M, s1));
+    right = _mm256_or_si256(right,
+        _mm256_and_si256(pro, _mm256_srlv_epi64(right, s1)));
+    pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, s1));
+    right = _mm256_or_si256(right,
+        _mm256_and_si256(pro, _mm256_srlv_epi64(right, s2)));
+    pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, s2));
+    right = _mm256_or_si256(right,
+        _mm256_and_si256(pro, _mm256_srlv_epi64(right, s4)));
+    open = _mm256_cmpeq_epi64(
+        _mm256_and_si256(_mm256_srlv_epi64(right, s1), P), zero);
+    flips = _mm256_or_si256(flips, _mm256_andnot_si256(open, right));
+
+    return orLanes(flips);
+}
+
+#else
+
+// No vector kernels on this architecture; fall back to scalar.
+uint64_t legalMovesSSE2(uint64_t own, uint64_t opp) {
+    return legalMovesScalar(own, opp);
+}
+
+uint64_t legalMovesAVX2(uint64_t own, uint64_t opp) {
+    return legalMovesScalar(own, opp);
+}
+
+uint64_t flipsAVX2(uint64_t own, uint64_t opp, int sq) {
+    return flipsScalar(own, opp, sq);
+}
+
+#endif
+
+/*
+ * The best kernels this CPU can run.
+ */
+SimdLevel bestSimdLevel() {
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+#endif
+    return SIMD_SCALAR;
+}
+
+/*
+ * Switches to the given kernels. Returns false, changing nothing, if the
+ * CPU can't run them.
+ */
+bool setSimdLevel(SimdLevel level) {
+    if (level < SIMD_SCALAR || level > bestSimdLevel()) return false;
+    switch (level) {
+    case SIMD_AVX2:
+        legalMovesKernel = legalMovesAVX2;
+        flipsKernel = flipsAVX2;
+        break;
+    case SIMD_SSE2:
+        legalMovesKernel = legalMovesSSE2;
+        flipsKernel = flipsScalar;
+        break;
+    default:
+        legalMovesKernel = legalMovesScalar;
+        flipsKernel = flipsScalar;
+        break;
+    }
+    currentLevel = level;
+    return true;
+}
+
+/*
+ * The kernels in use.
+ */
+SimdLevel simdLevel() {
+    return currentLevel;
+}
+
+const char *simdName(SimdLevel level) {
+    static const char *names[NUM_SIMD_LEVELS] = { "scalar", "sse2", "avx2" };
+    return (level >= 0 && level < NUM_SIMD_LEVELS) ? names[level] : "?";
+}
@@ -0,0 +1,34 @@
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#include <stdint.h>
+
+/*
+ * Vectorized move generation and flip calculation. legalMoveMask() and
+ * flipMask() in bitboard.h call through the two kernel pointers below,
+ * which are set at startup to the fastest kernels the CPU supports. The
+ * scalar kernels are the reference the others are tested against.
+ */
+
+enum SimdLevel {
+    SIMD_SCALAR,
+    SIMD_SSE2,   // Two directions per 128-bit vector; scalar flips
+    SIMD_AVX2,   // Four directions per 256-bit vector
+    NUM_SIMD_LEVELS
+};
+
+extern uint64_t (*legalMovesKernel)(uint64_t own, uint64_t opp);
+extern uint64_t (*flipsKernel)(uint64_t own, uint64_t opp, int sq);
+
+uint64_t legalMovesScalar(uint64_t own, uint64_t opp);
+uint64_t flipsScalar(uint64_t own, uint64_t opp, int sq);
+uint64_t legalMovesSSE2(uint64_t own, uint64_t opp);
+uint64_t legalMovesAVX2(uint64_t own, uint64_t opp);
+uint64_t flipsAVX2(uint64_t own, uint64_t opp, int sq);
+
+SimdLevel bestSimdLevel();
+bool setSimdLevel(SimdLevel level);
+SimdLevel simdLevel();
+const char *simdName(SimdLevel level);
+
+#endif
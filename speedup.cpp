@@ -0,0 +1,61 @@
+#include <cstdio>
+#include <cstdlib>
+#include "common.h"
+#include "board.h"
+#include "search.h"
+
+// Positions searched per thread count, reached by random play from the
+// start position.
+#define NUM_POSITIONS 8
+#define POSITION_PLIES 20
+
+/*
+ * Reports nodes per second and time-to-depth speedup of the Lazy SMP
+ * search for 1, 2, 4, ... threads up to the given maximum.
+ *
+ * usage: speedup [max threads] [depth]
+ */
+int main(int argc, char *argv[]) {
+    int maxThreads = (argc > 1) ? atoi(argv[1]) : 4;
+    int depth = (argc > 2) ? atoi(argv[2]) : 10;
+
+    // Pick the same positions every run.
+    Board positions[NUM_POSITIONS];
+    Side sides[NUM_POSITIONS];
+    srand(1);
+    for (int i = 0; i < NUM_POSITIONS; i++) {
+        Side side = BLACK;
+        for (int ply = 0; ply < POSITION_PLIES; ply++) {
+            uint64_t moves = positions[i].legalMoves(side);
+            if (moves == 0) break;
+            for (int k = rand() % popCount(moves); k > 0; k--)
+                moves &= moves - 1;
+            positions[i].makeMove(firstSquare(moves), side);
+            side = opponent(side);
+        }
+        sides[i] = side;
+    }
+
+    TranspositionTable tt(DEFAULT_TT_MB);
+    Search search;
+    search.tt = &tt;
+
+    long baseMs = 0;
+    printf("threads,ms,nodes,nps,speedup\n");
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        search.setThreads(threads);
+        long ms = 0;
+        uint64_t nodes = 0;
+        for (int i = 0; i < NUM_POSITIONS; i++) {
+            tt.clear();
+            SearchResult result = search.run(&positions[i], sides[i], depth);
+            ms += result.ms;
+            nodes += result.nodes;
+        }
+        if (threads == 1) baseMs = ms;
+        printf("%d,%ld,%lu,%lu,%.2f\n", threads, ms, (unsigned long) nodes,
+               (unsigned long) (nodes * 1000 / (ms + 1)),
+               (double) baseMs / (ms ? ms : 1));
+    }
+    return 0;
+}
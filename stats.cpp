@@ -0,0 +1,158 @@
+#include <cstring>
+#include "search.h"
+
+/*
+ * Output of the search instrumentation: a JSON line per search for logs,
+ * and Chrome trace files (chrome://tracing, Perfetto) with one track per
+ * thread.
+ */
+
+#ifdef SEARCH_STATS
+
+/*
+ * Adds the counters of one thread to a total.
+ */
+static void addCounters(SearchStats *total, SearchStats *s) {
+    for (int ply = 0; ply < MAX_PLY; ply++) {
+        total->plyNodes[ply] += s->plyNodes[ply];
+        total->plyCutoffs[ply] += s->plyCutoffs[ply];
+    }
+    total->ttProbes += s->ttProbes;
+    total->ttHits += s->ttHits;
+    total->ttCutoffs += s->ttCutoffs;
+    total->evalCalls += s->evalCalls;
+    total->probCutTries += s->probCutTries;
+    total->probCutCuts += s->probCutCuts;
+}
+
+/*
+ * Writes an array of per-ply counts up to the last nonzero one.
+ */
+static void writePlyArray(FILE *out, uint64_t *counts) {
+    int plies = MAX_PLY;
+    while (plies > 0 && counts[plies - 1] == 0) plies--;
+    fprintf(out, "[");
+    for (int ply = 0; ply < plies; ply++)
+        fprintf(out, "%s%lu", ply ? "," : "", (unsigned long) counts[ply]);
+    fprintf(out, "]");
+}
+
+#endif
+
+/*
+ * Writes a move as "x,y", or "pass".
+ */
+static void writeMove(FILE *out, int move) {
+    if (move < 0) fprintf(out, "\"pass\"");
+    else fprintf(out, "\"%d,%d\"", move % 8, move / 8);
+}
+
+/*
+ * Writes the last run() as one line of JSON: its time and nodes, every
+ * iteration of the main thread with its effective branching factor (its
+ * nodes over those of the one before), the endgame solve and, with
+ * SEARCH_STATS, the counters summed over all threads.
+ */
+void Search::writeStatsLine(FILE *out) {
+    SearchStats *s = &instrument;
+    uint64_t total = nodes;
+    for (unsigned int i = 0; i < helpers.size(); i++)
+        total += helpers[i]->nodes;
+
+    fprintf(out, "{\"us\":%ld,\"nodes\":%lu,\"threads\":%d,\"iterations\":[",
+            s->endUs - s->startUs, (unsigned long) (total
+                + s->endgameNodes), threads());
+    for (int i = 0; i < s->numIterations; i++) {
+        IterationStats *it = &s->iterations[i];
+        fprintf(out, "%s{\"depth\":%d,\"completed\":%s,\"score\":%d,"
+                "\"move\":", i ? "," : "", it->depth,
+                it->completed ? "true" : "false", it->score);
+        writeMove(out, it->move);
+        fprintf(out, ",\"nodes\":%lu,\"us\":%ld", (unsigned long) it->nodes,
+                it->endUs - it->startUs);
+        if (i > 0 && s->iterations[i - 1].nodes > 0)
+            fprintf(out, ",\"ebf\":%.2f",
+                    (double) it->nodes / s->iterations[i - 1].nodes);
+        fprintf(out, "}");
+    }
+    fprintf(out, "]");
+
+    if (s->endgameEndUs) {
+        fprintf(out, ",\"endgame\":{\"nodes\":%lu,\"us\":%ld}",
+                (unsigned long) s->endgameNodes,
+                s->endgameEndUs - s->endgameStartUs);
+    }
+
+#ifdef SEARCH_STATS
+    SearchStats sum;
+    memset(&sum, 0, sizeof(sum));
+    addCounters(&sum, s);
+    for (unsigned int i = 0; i < helpers.size(); i++)
+        addCounters(&sum, &helpers[i]->instrument);
+    fprintf(out, ",\"counters\":{\"ply_nodes\":");
+    writePlyArray(out, sum.plyNodes);
+    fprintf(out, ",\"ply_cutoffs\":");
+    writePlyArray(out, sum.plyCutoffs);
+    fprintf(out, ",\"tt_probes\":%lu,\"tt_hits\":%lu,\"tt_hit_rate\":%.3f,"
+            "\"tt_cutoffs\":%lu,\"evals\":%lu,\"probcut_tries\":%lu,"
+            "\"probcut_cuts\":%lu}",
+            (unsigned long) sum.ttProbes, (unsigned long) sum.ttHits,
+            sum.ttProbes ? (double) sum.ttHits / sum.ttProbes : 0.0,
+            (unsigned long) sum.ttCutoffs, (unsigned long) sum.evalCalls,
+            (unsigned long) sum.probCutTries,
+            (unsigned long) sum.probCutCuts);
+#endif
+    fprintf(out, "}\n");
+}
+
+/*
+ * Writes the iterations of one thread as trace events, with times counted
+ * from origin.
+ */
+static void writeThreadEvents(FILE *out, SearchStats *s, int tid,
+                              long origin) {
+    fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}", tid,
+            tid ? "helper" : "main", tid);
+    uint64_t cumulative = 0;
+    for (int i = 0; i < s->numIterations; i++) {
+        IterationStats *it = &s->iterations[i];
+        cumulative += it->nodes;
+        fprintf(out, ",\n{\"name\":\"depth %d\",\"cat\":\"iteration\","
+                "\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%ld,\"dur\":%ld,"
+                "\"args\":{\"nodes\":%lu,\"score\":%d,\"completed\":%s,"
+                "\"move\":", it->depth, tid, it->startUs - origin,
+                it->endUs - it->startUs, (unsigned long) it->nodes,
+                it->score, it->completed ? "true" : "false");
+        writeMove(out, it->move);
+        fprintf(out, "}}");
+        fprintf(out, ",\n{\"name\":\"nodes %d\",\"ph\":\"C\",\"pid\":1,"
+                "\"tid\":%d,\"ts\":%ld,\"args\":{\"nodes\":%lu}}", tid, tid,
+                it->endUs - origin, (unsigned long) cumulative);
+    }
+}
+
+/*
+ * Writes the last run() as a Chrome trace: a span for the whole search,
+ * one for each iteration of every thread and one for the endgame solve,
+ * plus a running node count per thread.
+ */
+void Search::writeTrace(FILE *out) {
+    SearchStats *s = &instrument;
+    long origin = s->startUs;
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":\"search\",\"ph\":\"X\",\"pid\":1,\"tid\":0,"
+            "\"ts\":0,\"dur\":%ld,\"args\":{\"threads\":%d}}",
+            s->endUs - origin, threads());
+    writeThreadEvents(out, s, 0, origin);
+    for (unsigned int i = 0; i < helpers.size(); i++)
+        writeThreadEvents(out, &helpers[i]->instrument, i + 1, origin);
+    if (s->endgameEndUs) {
+        fprintf(out, ",\n{\"name\":\"endgame\",\"ph\":\"X\",\"pid\":1,"
+                "\"tid\":0,\"ts\":%ld,\"dur\":%ld,\"args\":{\"nodes\":%lu}}",
+                s->endgameStartUs - origin,
+                s->endgameEndUs - s->endgameStartUs,
+                (unsigned long) s->endgameNodes);
+    }
+    fprintf(out, "\n]}\n");
+}
@@ -0,0 +1,94 @@
+#ifndef __TABLES_H__
+#define __TABLES_H__
+
+#include <stdint.h>
+
+/*
+ * Lookup tables generated by the compiler. Everything here is constexpr,
+ * so the tables sit in the read-only data of the binary and cost nothing
+ * at startup.
+ */
+
+// The 8 directions, as steps in x and y and as a step in square index.
+// Directions 0-3 go towards higher square indices, 4-7 towards lower.
+#define NUM_DIRECTIONS 8
+constexpr int DIRECTION_DX[NUM_DIRECTIONS] = { 1, 0, 1, -1, -1, 0, -1, 1 };
+constexpr int DIRECTION_DY[NUM_DIRECTIONS] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+constexpr int DIRECTION_STEP[NUM_DIRECTIONS] = { 1, 8, 9, 7, -1, -8, -9, -7 };
+
+/*
+ * A table of one bitboard per square.
+ */
+struct SquareMasks {
+    uint64_t mask[64];
+    constexpr uint64_t operator[](int sq) const { return mask[sq]; }
+};
+
+/*
+ * A table of one bitboard per direction and square.
+ */
+struct RayMasks {
+    SquareMasks dir[NUM_DIRECTIONS];
+    constexpr const SquareMasks &operator[](int d) const { return dir[d]; }
+};
+
+/*
+ * All squares from sq (not included) to the edge of the board in
+ * direction d.
+ */
+constexpr uint64_t rayMask(int sq, int d) {
+    uint64_t ray = 0;
+    int x = sq % 8 + DIRECTION_DX[d];
+    int y = sq / 8 + DIRECTION_DY[d];
+    while (x >= 0 && x < 8 && y >= 0 && y < 8) {
+        ray |= (uint64_t) 1 << (x + 8 * y);
+        x += DIRECTION_DX[d];
+        y += DIRECTION_DY[d];
+    }
+    return ray;
+}
+
+constexpr RayMasks makeRayMasks() {
+    RayMasks rays = {};
+    for (int d = 0; d < NUM_DIRECTIONS; d++)
+        for (int sq = 0; sq < 64; sq++)
+            rays.dir[d].mask[sq] = rayMask(sq, d);
+    return rays;
+}
+
+/*
+ * What one disc on each square is worth to Board::score(): every disc counts
+ * 1, corners get +9, other edge squares +2, edge squares next to a corner
+ * -6 on top of that and squares diagonally next to a corner -11.
+ */
+struct SquareWeights {
+    int weight[64];
+    constexpr int operator[](int sq) const { return weight[sq]; }
+};
+
+constexpr SquareWeights makeSquareWeights() {
+    SquareWeights weights = {};
+    for (int sq = 0; sq < 64; sq++) {
+        int x = sq % 8, y = sq / 8;
+        bool xEdge = (x == 0 || x == 7), yEdge = (y == 0 || y == 7);
+        bool xNext = (x == 1 || x == 6), yNext = (y == 1 || y == 6);
+        int w = 1;
+        if (xEdge && yEdge) w += 9;
+        else if (xEdge || yEdge) w += 2;
+        if ((xEdge && yNext) || (yEdge && xNext)) w -= 6;
+        if (xNext && yNext) w -= 11;
+        weights.weight[sq] = w;
+    }
+    return weights;
+}
+
+// RAY_MASKS[d][sq] is rayMask(sq, d).
+inline constexpr RayMasks RAY_MASKS = makeRayMasks();
+inline constexpr SquareWeights SQUARE_WEIGHTS = makeSquareWeights();
+
+static_assert(SQUARE_WEIGHTS[0] == 10 && SQUARE_WEIGHTS[1] == -3
+              && SQUARE_WEIGHTS[2] == 3 && SQUARE_WEIGHTS[9] == -10
+              && SQUARE_WEIGHTS[10] == 1 && SQUARE_WEIGHTS[63] == 10,
+              "square weights differ from the original table");
+
+#endif
@@ -0,0 +1,394 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "common.h"
+#include "board.h"
+#include "eval.h"
+#include "book.h"
+#include "record.h"
+
+// Number of random games to play through for each check.
+#define NUM_GAMES 2000
+
+static int failures = 0;
+
+// Every position checked, with its score, for checkBatch().
+static vector<uint64_t> batchBlack;
+static vector<uint64_t> batchWhite;
+static vector<Side> batchSides;
+static vector<int> batchScores;
+
+/*
+ * Picks a random legal move for the given side, or -1 if it has to pass.
+ */
+static int randomMove(uint64_t moves) {
+    int n = popCount(moves);
+    if (n == 0) return -1;
+    for (int k = rand() % n; k > 0; k--) moves &= moves - 1;
+    return firstSquare(moves);
+}
+
+/*
+ * Compares the bitboard move generator against the square-by-square scan.
+ */
+static void checkMoveGen(Board *board, Side side, int game, int ply) {
+    uint64_t fast = board->legalMoves(side);
+    uint64_t slow = board->scanMoves(side);
+    if (fast != slow) {
+        printf("Move generator mismatch in game %d, ply %d: "
+               "legalMoves %016lx, scanMoves %016lx\n", game, ply,
+               (unsigned long) fast, (unsigned long) slow);
+        failures++;
+    }
+}
+
+/*
+ * Plays every legal move both through doMove() and the square-by-square
+ * doMoveScan(), and checks that makeMove()/undoMove() round-trips.
+ */
+static void checkFlips(Board *board, Side side, int game, int ply) {
+    for (uint64_t moves = board->legalMoves(side); moves; moves &= moves - 1) {
+        int sq = firstSquare(moves);
+        Move move(sq % 8, sq / 8);
+        Board fast = *board;
+        Board slow = *board;
+        fast.doMove(&move, side);
+        slow.doMoveScan(&move, side);
+        if (fast.pieces(BLACK) != slow.pieces(BLACK)
+            || fast.pieces(WHITE) != slow.pieces(WHITE)) {
+            printf("Flip mismatch in game %d, ply %d, move (%d, %d)\n",
+                   game, ply, move.getX(), move.getY());
+            failures++;
+        }
+
+        Board undone = *board;
+        uint64_t flipped = undone.makeMove(sq, side);
+        if (flipped != (board->pieces(side == BLACK ? WHITE : BLACK)
+                        & ~fast.pieces(side == BLACK ? WHITE : BLACK))) {
+            printf("Wrong flip mask in game %d, ply %d, move (%d, %d)\n",
+                   game, ply, move.getX(), move.getY());
+            failures++;
+        }
+        if (undone.hashKey(BLACK) != undone.computeHash()
+            || fast.hashKey(BLACK) != fast.computeHash()
+            || slow.hashKey(BLACK) != slow.computeHash()) {
+            printf("Stale Zobrist hash in game %d, ply %d, move (%d, %d)\n",
+                   game, ply, move.getX(), move.getY());
+            failures++;
+        }
+        undone.undoMove(sq, flipped, side);
+        if (undone.pieces(BLACK) != board->pieces(BLACK)
+            || undone.pieces(WHITE) != board->pieces(WHITE)
+            || undone.hashKey(side) != board->hashKey(side)) {
+            printf("undoMove mismatch in game %d, ply %d, move (%d, %d)\n",
+                   game, ply, move.getX(), move.getY());
+            failures++;
+        }
+    }
+}
+
+/*
+ * Checks the incrementally updated pattern indices against a fresh set, and
+ * that the default weights reproduce Board::score().
+ */
+static void checkEval(Board *board, Eval *eval, int game, int ply) {
+    Eval fresh;
+    fresh.setBoard(board);
+    for (int f = 0; f < NUM_FEATURES; f++) {
+        if (eval->index[f] != fresh.index[f]) {
+            printf("Stale pattern index %d in game %d, ply %d\n",
+                   f, game, ply);
+            failures++;
+            break;
+        }
+    }
+    int expected = board->score(BLACK) - board->score(WHITE);
+    if (fresh.patternScore(board, BLACK) != expected
+        || fresh.patternScore(board, WHITE) != -expected) {
+        printf("Default pattern score %d in game %d, ply %d, expected %d\n",
+               fresh.patternScore(board, BLACK), game, ply, expected);
+        failures++;
+    }
+}
+
+/*
+ * Checks that discs found stable earlier in the game were never flipped,
+ * and adds the ones stable now.
+ */
+static void checkStability(Board *board, uint64_t *stable, int game,
+                           int ply) {
+    uint64_t black = board->pieces(BLACK);
+    uint64_t white = board->pieces(WHITE);
+    if ((stable[BLACK] & ~black) || (stable[WHITE] & ~white)) {
+        printf("Stable disc flipped in game %d, ply %d\n", game, ply);
+        failures++;
+    }
+    stable[BLACK] |= Eval::stableDiscs(black, white);
+    stable[WHITE] |= Eval::stableDiscs(white, black);
+}
+
+/*
+ * Checks the delta swap transforms against moving each square through
+ * transformSquare(), and that every symmetry of the position has the same
+ * canonical form and book key, the same legal moves moved by the symmetry,
+ * and a canonical form whose moves map back to its own legal moves.
+ */
+static void checkSymmetry(Board *board, Side side, int game, int ply) {
+    uint64_t own = board->pieces(side);
+    uint64_t opp = board->pieces(opponent(side));
+    uint64_t moves = legalMoveMask(own, opp);
+    uint64_t canonOwn, canonOpp;
+    int canonSym = board->canonical(side, &canonOwn, &canonOpp);
+    uint64_t canonMoves = legalMoveMask(canonOwn, canonOpp);
+    int sym;
+    uint64_t key = OpeningBook::canonicalKey(own, opp, &sym);
+    if (transformDiscs(own, canonSym) != canonOwn
+        || transformDiscs(opp, canonSym) != canonOpp || sym != canonSym) {
+        printf("Canonical form mismatch in game %d, ply %d\n", game, ply);
+        failures++;
+    }
+
+    for (int s = 0; s < NUM_SYMMETRIES; s++) {
+        uint64_t tOwn = 0;
+        for (uint64_t b = own; b; b &= b - 1)
+            tOwn |= (uint64_t) 1 << transformSquare(firstSquare(b), s);
+        uint64_t tOpp = transformDiscs(opp, s);
+        Board transformed = *board;
+        transformed.transform(s);
+        Board rebuilt;
+        rebuilt.setPieces(transformDiscs(board->pieces(BLACK), s),
+                          transformDiscs(board->pieces(WHITE), s));
+        if (transformDiscs(own, s) != tOwn
+            || transformed.pieces(side) != tOwn
+            || transformed.pieces(opponent(side)) != tOpp
+            || transformed.hashKey(side) != rebuilt.hashKey(side)) {
+            printf("Symmetry %d transform mismatch in game %d, ply %d\n", s,
+                   game, ply);
+            failures++;
+        }
+
+        uint64_t cOwn, cOpp;
+        int tSym = transformed.canonical(side, &cOwn, &cOpp);
+        uint64_t tMoves = legalMoveMask(tOwn, tOpp);
+        if (cOwn != canonOwn || cOpp != canonOpp
+            || OpeningBook::canonicalKey(tOwn, tOpp, &sym) != key
+            || tMoves != transformDiscs(moves, s)) {
+            printf("Symmetry %d mismatch in game %d, ply %d\n", s, game, ply);
+            failures++;
+        }
+        for (uint64_t m = canonMoves; m; m &= m - 1) {
+            if (!((tMoves >> inverseSquare(firstSquare(m), tSym)) & 1)) {
+                printf("Symmetry %d maps a canonical move to an illegal one"
+                       " in game %d, ply %d\n", s, game, ply);
+                failures++;
+                break;
+            }
+        }
+        for (int sq = 0; sq < 64; sq++) {
+            if (inverseSquare(transformSquare(sq, s), s) != sq) {
+                printf("Symmetry %d doesn't invert on square %d\n", s, sq);
+                failures++;
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Checks every SIMD kernel the CPU can run against the scalar reference,
+ * for both sides' moves and every move's flips.
+ */
+static void checkSimd(Board *board, int game, int ply) {
+    for (int level = SIMD_SSE2; level <= bestSimdLevel(); level++) {
+        setSimdLevel((SimdLevel) level);
+        for (int s = 0; s < 2; s++) {
+            uint64_t own = board->pieces((Side) s);
+            uint64_t opp = board->pieces(opponent((Side) s));
+            uint64_t moves = legalMoveMaskScalar(own, opp);
+            if (legalMoveMask(own, opp) != moves) {
+                printf("%s legal moves mismatch in game %d, ply %d\n",
+                       simdName((SimdLevel) level), game, ply);
+                failures++;
+            }
+            uint64_t empty = ~(own | opp);
+            for (; empty; empty &= empty - 1) {
+                int sq = firstSquare(empty);
+                if (flipMask(own, opp, sq) != flipMaskScalar(own, opp, sq)) {
+                    printf("%s flips mismatch in game %d, ply %d, square %d\n",
+                           simdName((SimdLevel) level), game, ply, sq);
+                    failures++;
+                }
+            }
+        }
+    }
+    setSimdLevel(bestSimdLevel());
+}
+
+/*
+ * Checks that batch evaluation with each kernel gives the same score as
+ * Eval::score() for every position the games went through.
+ */
+static void checkBatch() {
+    int count = batchScores.size();
+    vector<int> scores(count);
+    for (int level = SIMD_SCALAR; level <= bestSimdLevel(); level++) {
+        setSimdLevel((SimdLevel) level);
+        Eval::scoreBatch(batchBlack.data(), batchWhite.data(),
+                         batchSides.data(), count, scores.data());
+        for (int i = 0; i < count; i++) {
+            if (scores[i] != batchScores[i]) {
+                printf("%s batch score mismatch at position %d: %d vs %d\n",
+                       simdName((SimdLevel) level), i, scores[i],
+                       batchScores[i]);
+                failures++;
+                break;
+            }
+        }
+    }
+    setSimdLevel(bestSimdLevel());
+}
+
+/*
+ * Writes the positions of a few random games to a position file and checks
+ * that the mapped file gives them back, that each converts to and from the
+ * setBoard() characters and to the same board, that every game goes
+ * through move notation and back unchanged, and that a file cut off in its
+ * header isn't appended to.
+ */
+static void checkRecords() {
+    const char *filename = "testboard.tmp";
+    remove(filename);
+    PositionWriter writer;
+    if (!writer.open(filename)) {
+        printf("could not open %s\n", filename);
+        failures++;
+        return;
+    }
+    vector<PositionRecord> written;
+    vector<Board> boards;
+    for (int game = 0; game < 20; game++) {
+        Board board;
+        Side side = BLACK;
+        while (!board.isDone()) {
+            int sq = randomMove(board.legalMoves(side));
+            if (sq >= 0) {
+                PositionRecord record;
+                recordFromBoard(&board, side, &record);
+                record.flags |= RECORD_MOVE
+                    | (board.count(BLACK) + board.count(WHITE) == 4
+                       ? RECORD_GAME_START : 0);
+                record.move = sq;
+                writer.write(&record);
+                written.push_back(record);
+                boards.push_back(board);
+                board.makeMove(sq, side);
+            }
+            side = opponent(side);
+        }
+    }
+    if (!writer.close()) failures++;
+
+    PositionFile file;
+    if (!file.open(filename) || file.size() != written.size()) {
+        printf("could not read back %s\n", filename);
+        failures++;
+        remove(filename);
+        return;
+    }
+    const PositionRecord *records = file.records();
+    for (size_t n = 0; n < file.size(); n++) {
+        const PositionRecord *r = &records[n];
+        Board board;
+        Side side = recordToBoard(r, &board);
+        char chars[64];
+        PositionRecord converted;
+        recordToChars(r, chars);
+        recordFromChars(chars, side, &converted);
+        if (memcmp(r, &written[n], sizeof(PositionRecord))
+            || board.hashKey(side) != boards[n].hashKey(side)
+            || converted.black != r->black || converted.white != r->white
+            || converted.flags != (r->flags & RECORD_WHITE_TO_MOVE)) {
+            printf("position record %lu doesn't round-trip\n",
+                   (unsigned long) n);
+            failures++;
+        }
+    }
+
+    for (size_t n = 0; n < file.size(); ) {
+        char text[GAME_TEXT_MAX];
+        int length = gameToText(records + n, file.size() - n, text);
+        PositionRecord game[60];
+        int count = gameFromText(text, game, 60);
+        bool same = count == length;
+        for (int i = 0; same && i < count; i++)
+            same = game[i].black == records[n + i].black
+                && game[i].white == records[n + i].white
+                && (game[i].flags & ~RECORD_SCORE) == records[n + i].flags
+                && game[i].move == records[n + i].move;
+        if (!same) {
+            printf("game at record %lu doesn't round-trip: %s\n",
+                   (unsigned long) n, text);
+            failures++;
+        }
+        n += length;
+    }
+    remove(filename);
+
+    // A file cut off inside the header can't be appended to.
+    FILE *partial = fopen(filename, "wb");
+    if (partial) {
+        fwrite("OTPR\0", 5, 1, partial);
+        fclose(partial);
+    }
+    if (!partial || writer.open(filename)) {
+        printf("position writer opened a file with a partial header\n");
+        failures++;
+    }
+    writer.close();
+    remove(filename);
+}
+
+int main(int argc, char *argv[]) {
+    srand(1);
+
+    for (int game = 0; game < NUM_GAMES; game++) {
+        Board board;
+        Eval eval;
+        uint64_t stable[2] = { 0, 0 };
+        Side side = BLACK;
+        for (int ply = 0; !board.isDone(); ply++) {
+            checkMoveGen(&board, BLACK, game, ply);
+            checkMoveGen(&board, WHITE, game, ply);
+            checkFlips(&board, side, game, ply);
+            checkEval(&board, &eval, game, ply);
+            checkStability(&board, stable, game, ply);
+            checkSymmetry(&board, side, game, ply);
+            checkSimd(&board, game, ply);
+
+            batchBlack.push_back(board.pieces(BLACK));
+            batchWhite.push_back(board.pieces(WHITE));
+            batchSides.push_back(side);
+            batchScores.push_back(eval.score(&board, side));
+
+            int sq = randomMove(board.legalMoves(side));
+            if (sq >= 0) {
+                eval.update(sq, board.flips(sq, side), side);
+                Move move(sq % 8, sq / 8);
+                board.doMove(&move, side);
+            }
+            side = (side == BLACK) ? WHITE : BLACK;
+        }
+    }
+
+    checkBatch();
+    checkRecords();
+
+    if (failures) {
+        printf("%d board checks failed\n", failures);
+        return 1;
+    }
+    printf("All board checks passed (kernels up to %s)\n",
+           simdName(bestSimdLevel()));
+    return 0;
+}
@@ -0,0 +1,448 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "common.h"
+#include "board.h"
+#include "endgame.h"
+#include "search.h"
+#include "player.h"
+#include "analyze.h"
+
+// Number of random endgame positions to check.
+#define NUM_POSITIONS 300
+// Most empties in a checked position; the reference solver is plain
+// minimax, so this has to stay small.
+#define MAX_EMPTIES 9
+
+// Lines, and analysis workers, for checking batch analysis.
+#define NUM_ANALYSIS_LINES 1000
+#define NUM_ANALYSIS_WORKERS 4
+// Positions, and their empties, for checking fixed-depth analysis near the
+// end of the game.
+#define NUM_DEPTH_POSITIONS 4
+#define DEPTH_EMPTIES 20
+
+// Positions, and their empties, for checking the endgame cutoffs.
+#define NUM_CUTOFF_POSITIONS 40
+#define CUTOFF_EMPTIES 14
+
+static int failures = 0;
+
+// Allocation counting: while countAllocations is set, every call to the
+// global operator new below is counted.
+static bool countAllocations = false;
+static long allocations = 0;
+
+void *operator new(size_t size) {
+    if (countAllocations) allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+/*
+ * Plain minimax to the end of the game: the final disc difference for the
+ * side to move.
+ */
+static int minimax(Board *board, Side side, bool passed) {
+    uint64_t moves = board->legalMoves(side);
+    if (moves == 0) {
+        if (passed) return board->count(side) - board->count(opponent(side));
+        return -minimax(board, opponent(side), true);
+    }
+    int best = -100;
+    for (; moves; moves &= moves - 1) {
+        int sq = firstSquare(moves);
+        uint64_t flipped = board->makeMove(sq, side);
+        int score = -minimax(board, opponent(side), false);
+        board->undoMove(sq, flipped, side);
+        if (score > best) best = score;
+    }
+    return best;
+}
+
+/*
+ * Plays random moves from the start until the given number of empties is
+ * left, and returns the side to move.
+ */
+static Side randomPosition(Board *board, int empties) {
+    Side side = BLACK;
+    while (64 - board->count(BLACK) - board->count(WHITE) > empties
+           && !board->isDone()) {
+        uint64_t moves = board->legalMoves(side);
+        if (moves) {
+            for (int k = rand() % popCount(moves); k > 0; k--)
+                moves &= moves - 1;
+            board->makeMove(firstSquare(moves), side);
+        }
+        side = opponent(side);
+    }
+    return side;
+}
+
+/*
+ * Checks the endgame solver, exact and win/loss/draw, against minimax:
+ * every other position with a table shared by all of them, so that the
+ * table cutoffs see results from earlier solves and other windows.
+ */
+static void checkEndgame(int n) {
+    static TranspositionTable tt(16);
+    Board board;
+    Side side = randomPosition(&board, 1 + n % MAX_EMPTIES);
+    int expected = minimax(&board, side, false);
+
+    Endgame endgame;
+    if (n % 2) endgame.tt = &tt;
+    EndgameResult wld = endgame.solve(&board, side, true);
+    EndgameResult exact = endgame.solve(&board, side, false);
+    int sign = (expected > 0) - (expected < 0);
+    if (exact.score != expected || wld.score != sign) {
+        printf("Endgame mismatch in position %d: minimax %d, exact %d, "
+               "wld %d\n", n, expected, exact.score, wld.score);
+        failures++;
+    }
+
+    // The move returned has to achieve the score.
+    if (exact.move >= 0) {
+        uint64_t flipped = board.makeMove(exact.move, side);
+        int score = -minimax(&board, opponent(side), false);
+        board.undoMove(exact.move, flipped, side);
+        if (score != expected) {
+            printf("Endgame move in position %d scores %d, not %d\n",
+                   n, score, expected);
+            failures++;
+        }
+    }
+}
+
+/*
+ * Checks that the table and stability cutoffs don't change what the
+ * endgame solver finds, on positions too deep for minimax and deep enough
+ * for every cutoff: each is solved without them, then with them and a
+ * table shared by all positions, exactly and for win/loss/draw.
+ */
+static void checkEndgameCutoffs() {
+    TranspositionTable tt(16);
+    for (int n = 0; n < NUM_CUTOFF_POSITIONS; n++) {
+        Board board;
+        Side side = randomPosition(&board, CUTOFF_EMPTIES);
+        Endgame plain;
+        plain.enhancedCutoffs = false;
+        plain.stabilityCutoffs = false;
+        EndgameResult expected = plain.solve(&board, side, false);
+
+        Endgame endgame;
+        endgame.tt = &tt;
+        EndgameResult wld = endgame.solve(&board, side, true);
+        EndgameResult exact = endgame.solve(&board, side, false);
+        int sign = (expected.score > 0) - (expected.score < 0);
+        if (exact.score != expected.score || wld.score != sign) {
+            printf("Endgame cutoffs change position %d: plain %d, exact %d, "
+                   "wld %d\n", n, expected.score, exact.score, wld.score);
+            failures++;
+        }
+    }
+}
+
+/*
+ * Writes a position as one line of batch analysis input.
+ */
+static void writePosition(FILE *file, Board *board, Side side) {
+    for (int sq = 0; sq < 64; sq++) {
+        uint64_t mask = (uint64_t) 1 << sq;
+        fputc((board->pieces(BLACK) & mask) ? 'b'
+              : (board->pieces(WHITE) & mask) ? 'w' : '-', file);
+    }
+    fprintf(file, " %c\n", (side == BLACK) ? 'b' : 'w');
+}
+
+/*
+ * Feeds batch analysis positions mixed with lines that aren't positions,
+ * on several workers, and checks that there is exactly one result per
+ * line, in input order, with "error" for just the bad lines.
+ */
+static void checkAnalysis() {
+    FILE *in = tmpfile();
+    FILE *out = tmpfile();
+    if (!in || !out) {
+        printf("could not make analysis files\n");
+        failures++;
+        return;
+    }
+    bool bad[NUM_ANALYSIS_LINES + 1];
+    for (int line = 1; line <= NUM_ANALYSIS_LINES; line++) {
+        bad[line] = (rand() % 2 == 0);
+        if (bad[line]) {
+            fprintf(in, "not a position %d\n", line);
+            continue;
+        }
+        Board board;
+        Side side = randomPosition(&board, 20 + rand() % 36);
+        writePosition(in, &board, side);
+    }
+    rewind(in);
+
+    Analyzer analyzer(NUM_ANALYSIS_WORKERS, 1);
+    analyzer.depth = 1;
+    long count = analyzer.run(in, out);
+    rewind(out);
+
+    char text[ANALYSIS_LINE_MAX];
+    long results = 0;
+    bool ok = (count == NUM_ANALYSIS_LINES);
+    while (fgets(text, sizeof(text), out)) {
+        results++;
+        char *rest;
+        long line = strtol(text, &rest, 10);
+        bool error = !strcmp(rest, "\terror\n");
+        if (line != results || line > NUM_ANALYSIS_LINES
+            || error != bad[line]) {
+            ok = false;
+            break;
+        }
+    }
+    if (!ok || results != NUM_ANALYSIS_LINES) {
+        printf("Batch analysis of %d lines goes wrong at result %ld\n",
+               NUM_ANALYSIS_LINES, results);
+        failures++;
+    }
+    fclose(in);
+    fclose(out);
+}
+
+/*
+ * Checks that a fixed-depth analysis of positions the endgame solver
+ * would take on searches them to just the depth asked for.
+ */
+static void checkAnalysisDepth() {
+    FILE *in = tmpfile();
+    FILE *out = tmpfile();
+    if (!in || !out) {
+        printf("could not make analysis files\n");
+        failures++;
+        return;
+    }
+    for (int n = 0; n < NUM_DEPTH_POSITIONS; n++) {
+        Board board;
+        Side side = randomPosition(&board, DEPTH_EMPTIES);
+        if (!board.legalMoves(side)) {
+            n--;
+            continue;
+        }
+        writePosition(in, &board, side);
+    }
+    rewind(in);
+
+    Analyzer analyzer(1, 1);
+    analyzer.depth = 2;
+    analyzer.run(in, out);
+    rewind(out);
+
+    char text[ANALYSIS_LINE_MAX];
+    int results = 0;
+    while (fgets(text, sizeof(text), out)) {
+        results++;
+        char move[16];
+        int score, depth;
+        if (sscanf(text, "%*d %15s %d %d", move, &score, &depth) != 3
+            || depth != 2) {
+            printf("Depth 2 analysis with %d empties gave: %s",
+                   DEPTH_EMPTIES, text);
+            failures++;
+        }
+    }
+    if (results != NUM_DEPTH_POSITIONS) {
+        printf("Depth 2 analysis gave %d results for %d positions\n",
+               results, NUM_DEPTH_POSITIONS);
+        failures++;
+    }
+    fclose(in);
+    fclose(out);
+}
+
+/*
+ * Checks that searching makes no heap allocations once the search, its
+ * helper threads and the transposition table are set up: midgame and
+ * endgame positions, with and without a timer.
+ */
+static void checkAllocations() {
+    TranspositionTable tt(16);
+    TimeManager timer;
+    Search search;
+    search.tt = &tt;
+    search.setThreads(2);
+
+    const int empties[] = { 56, 40, 24, 14 };
+    Board boards[4];
+    Side sides[4];
+    for (int i = 0; i < 4; i++)
+        sides[i] = randomPosition(&boards[i], empties[i]);
+
+    countAllocations = true;
+    allocations = 0;
+    for (int i = 0; i < 4; i++) {
+        search.run(&boards[i], sides[i], 6);
+        timer.startFixed(20);
+        search.run(&boards[i], sides[i], MAX_PLY, &timer);
+    }
+    countAllocations = false;
+
+    if (allocations) {
+        printf("Search made %ld heap allocations\n", allocations);
+        failures++;
+    }
+}
+
+/*
+ * Checks that Multi-ProbCut prunes when it is on, and that a threshold of
+ * 0 searches exactly the tree of a search with no cut parameters at all.
+ */
+static void checkProbCut() {
+    const int empties[] = { 50, 40, 30 };
+    uint64_t nodes[3] = { 0, 0, 0 };
+    for (int i = 0; i < 3; i++) {
+        Board board;
+        Side side = randomPosition(&board, empties[i]);
+        for (int mode = 0; mode < 3; mode++) {
+            Search search;
+            search.probCut = (mode == 1) ? 0 : DEFAULT_PROBCUT_THRESHOLD;
+            if (mode == 2) ProbCut::clear();
+            nodes[mode] += search.run(&board, side, 8).nodes;
+            ProbCut::defaultParams();
+        }
+    }
+    if (nodes[1] != nodes[2] || nodes[0] >= nodes[1]) {
+        printf("ProbCut check failed: %lu nodes pruned, %lu with threshold "
+               "0, %lu without parameters\n", (unsigned long) nodes[0],
+               (unsigned long) nodes[1], (unsigned long) nodes[2]);
+        failures++;
+    }
+}
+
+/*
+ * Plays games between a pondering player and a plain one, without a clock
+ * and with a short one, and checks that every move is legal whether the
+ * ponder search is hit, missed or interrupted by the end of the game. The
+ * reply has to be guessed right at least once, and a move after a hit has
+ * to be the ponder search's.
+ */
+static void checkPonder() {
+    for (int timed = 0; timed < 2; timed++) {
+        Player *players[2];
+        players[BLACK] = new Player(BLACK, new Board());
+        players[WHITE] = new Player(WHITE, new Board());
+        players[BLACK]->ponder = true;
+        players[BLACK]->searchDepth = players[WHITE]->searchDepth = 4;
+
+        Board board;
+        Side side = BLACK;
+        Move *last = NULL;
+        int msLeft[2] = { 3000, 3000 };
+        while (!board.isDone()) {
+            Player *player = players[side];
+            int hits = player->ponderHits;
+            int searches = player->searches;
+            long start = nowMs();
+            Move *move = player->doMove(last, timed ? msLeft[side] : -1);
+            msLeft[side] -= nowMs() - start;
+            if (!board.checkMove(move, side)) {
+                printf("Illegal move from a %s player\n",
+                       player->ponder ? "pondering" : "plain");
+                failures++;
+                delete move;
+                break;
+            }
+
+            // A hit plays the ponder search's move without searching
+            // again; anything else takes exactly one new search.
+            bool hit = (player->ponderHits > hits);
+            if (player->searches - searches != (hit ? 0 : 1)) {
+                printf("Move %s a ponder hit came from the %s search\n",
+                       hit ? "after" : "without", hit ? "new" : "ponder");
+                failures++;
+            }
+
+            if (move) board.doMove(move, side);
+            delete last;
+            last = move;
+            side = opponent(side);
+        }
+        delete last;
+        if (timed && (msLeft[BLACK] < 0 || msLeft[WHITE] < 0)) {
+            printf("Player ran out of time in the ponder game\n");
+            failures++;
+        }
+        if (players[BLACK]->ponderHits == 0) {
+            printf("No ponder hits in the %s ponder game\n",
+                   timed ? "timed" : "untimed");
+            failures++;
+        }
+        delete players[BLACK];
+        delete players[WHITE];
+    }
+}
+
+/*
+ * Checks that the instrumentation adds up: one completed record per
+ * iteration whose nodes sum to the search's, and with SEARCH_STATS as
+ * many nodes counted per ply.
+ */
+static void checkStats() {
+    Board board;
+    Side side = randomPosition(&board, 40);
+    TranspositionTable tt(16);
+    Search search;
+    search.tt = &tt;
+    SearchResult result = search.run(&board, side, 7);
+    SearchStats *stats = search.searchStats();
+
+    uint64_t nodes = 0;
+    bool ok = (stats->numIterations == 7);
+    for (int i = 0; i < stats->numIterations; i++) {
+        nodes += stats->iterations[i].nodes;
+        ok = ok && stats->iterations[i].completed
+            && stats->iterations[i].depth == i + 1;
+    }
+    ok = ok && nodes == result.nodes && stats->endUs >= stats->startUs;
+#ifdef SEARCH_STATS
+    uint64_t plyNodes = 0;
+    for (int ply = 0; ply < MAX_PLY; ply++)
+        plyNodes += stats->plyNodes[ply];
+    ok = ok && plyNodes == result.nodes && stats->evalCalls > 0
+        && stats->ttHits <= stats->ttProbes;
+#endif
+    if (!ok) {
+        printf("Search statistics don't add up\n");
+        failures++;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    srand(1);
+
+    for (int n = 0; n < NUM_POSITIONS; n++)
+        checkEndgame(n);
+    checkEndgameCutoffs();
+    checkAnalysis();
+    checkAnalysisDepth();
+    checkAllocations();
+    checkProbCut();
+    checkPonder();
+    checkStats();
+
+    if (failures) {
+        printf("%d search checks failed\n", failures);
+        return 1;
+    }
+    printf("All search checks passed\n");
+    return 0;
+}
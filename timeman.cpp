@@ -0,0 +1,147 @@
+#include <time.h>
+#include "timeman.h"
+
+/*
+ * Milliseconds on a monotonic clock.
+ */
+long nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/*
+ * Microseconds on the same clock.
+ */
+long nowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+/*
+ * Make a time manager with no limit until start() is called.
+ */
+TimeManager::TimeManager() {
+    unlimited = true;
+    softLimit = 0;
+    hardLimit = 0;
+    startTime = 0;
+    scale = 100;
+    stopped = false;
+}
+
+/*
+ * Destructor for the time manager.
+ */
+TimeManager::~TimeManager() {
+}
+
+/*
+ * Starts the clock for one move. msLeft is the time left for the rest of
+ * the game, or -1 for no limit; empties is the number of empty squares,
+ * which bounds how many more moves we have to make.
+ *
+ * A search may already be running on this clock without a limit, as when
+ * pondering. Clearing unlimited is a release store, and the search reads
+ * it with an acquire load before the limits and the start time, so it
+ * never sees a half-started clock.
+ */
+void TimeManager::start(int msLeft, int empties) {
+    startTime.store(nowMs(), std::memory_order_relaxed);
+    scale.store(100, std::memory_order_relaxed);
+    stopped.store(false, std::memory_order_relaxed);
+    if (msLeft < 0) {
+        unlimited.store(true, std::memory_order_release);
+        return;
+    }
+
+    // Keep a reserve that grows with the clock, and split the rest evenly
+    // over our remaining moves, of which there are about half the empties.
+    int usable = msLeft - TIME_RESERVE - msLeft / 20;
+    if (usable < 1) usable = 1;
+    int movesLeft = (empties + 1) / 2;
+    if (movesLeft < 1) movesLeft = 1;
+
+    int soft = usable / movesLeft;
+    if (soft < 1) soft = 1;
+
+    // A running iteration may overrun the target, but never by more than a
+    // quarter of what is left.
+    int hard = 4 * soft;
+    if (hard > usable / 4) hard = usable / 4;
+    if (hard < soft) hard = soft;
+    softLimit.store(soft, std::memory_order_relaxed);
+    hardLimit.store(hard, std::memory_order_relaxed);
+    unlimited.store(false, std::memory_order_release);
+}
+
+/*
+ * Starts the clock for a search that may take up to ms milliseconds,
+ * whatever the game clock says.
+ */
+void TimeManager::startFixed(int ms) {
+    if (ms < 1) ms = 1;
+    startTime.store(nowMs(), std::memory_order_relaxed);
+    scale.store(100, std::memory_order_relaxed);
+    stopped.store(false, std::memory_order_relaxed);
+    softLimit.store(ms, std::memory_order_relaxed);
+    hardLimit.store(ms, std::memory_order_relaxed);
+    unlimited.store(false, std::memory_order_release);
+}
+
+/*
+ * Ends the search running on this clock as if its time were up: it stops
+ * at its next clock check. Safe to call from another thread.
+ */
+void TimeManager::stop() {
+    stopped.store(true, std::memory_order_relaxed);
+}
+
+/*
+ * Called after every completed iteration. A best move that keeps changing
+ * earns more time; one that stays put lets us move sooner.
+ */
+void TimeManager::iterationDone(bool bestMoveChanged) {
+    int s = scale.load(std::memory_order_relaxed);
+    if (bestMoveChanged) {
+        s = s * 3 / 2;
+        if (s > 300) s = 300;
+    }
+    else {
+        s = s * 9 / 10;
+        if (s < 50) s = 50;
+    }
+    scale.store(s, std::memory_order_relaxed);
+}
+
+/*
+ * Returns true if there is time to start another iteration. The next one
+ * usually takes longer than all previous ones together, so don't start it
+ * unless less than half of the target has gone.
+ */
+bool TimeManager::moreTime() {
+    if (stopped.load(std::memory_order_relaxed)) return false;
+    if (unlimited.load(std::memory_order_acquire)) return true;
+    long target = (long) softLimit.load(std::memory_order_relaxed)
+        * scale.load(std::memory_order_relaxed) / 100;
+    int hard = hardLimit.load(std::memory_order_relaxed);
+    if (target > hard) target = hard;
+    return 2 * elapsed() < target;
+}
+
+/*
+ * Returns true once the hard deadline has passed or stop() was called.
+ */
+bool TimeManager::outOfTime() {
+    if (stopped.load(std::memory_order_relaxed)) return true;
+    if (unlimited.load(std::memory_order_acquire)) return false;
+    return elapsed() >= hardLimit.load(std::memory_order_relaxed);
+}
+
+/*
+ * Milliseconds since start() was called.
+ */
+int TimeManager::elapsed() {
+    return (int) (nowMs() - startTime.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,47 @@
+#ifndef __TIMEMAN_H__
+#define __TIMEMAN_H__
+
+#include <atomic>
+
+// Milliseconds always kept in reserve for process and pipe overhead; the
+// Java wrapper alone polls for our move every 100 ms.
+#define TIME_RESERVE 150
+
+// How often, in nodes, the search looks at the clock. Must be a power of 2.
+#define TIME_CHECK_NODES 1024
+
+/*
+ * Decides how long one move may take given the time left in the game. The
+ * soft limit is the target and decides whether another iteration is
+ * started; the hard limit is the deadline a running search is stopped at.
+ */
+class TimeManager {
+
+public:
+    TimeManager();
+    ~TimeManager();
+
+    void start(int msLeft, int empties);
+    void startFixed(int ms);
+    void stop();
+    void iterationDone(bool bestMoveChanged);
+    bool moreTime();
+    bool outOfTime();
+    int elapsed();
+
+    // The clock can be restarted, or stopped, from another thread while a
+    // search is running on it, so everything it reads is atomic.
+    std::atomic<bool> unlimited;
+    std::atomic<int> softLimit;
+    std::atomic<int> hardLimit;
+
+private:
+    std::atomic<long> startTime;
+    std::atomic<int> scale; // Percent of softLimit currently allowed
+    std::atomic<bool> stopped; // Set by stop(), from any thread
+};
+
+long nowMs();
+long nowUs();
+
+#endif
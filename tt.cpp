@@ -0,0 +1,158 @@
+#include <cstdlib>
+#include <cstring>
+#include "tt.h"
+
+/*
+ * Layout of TTSlot::data, low bits first: 16 bits of score, 8 of depth, 2
+ * of bound, 8 of move (255 for none) and 8 of generation.
+ */
+static inline uint64_t pack(int score, int depth, int bound, int move,
+                            int generation) {
+    return (uint64_t) (uint16_t) score
+        | (uint64_t) depth << 16
+        | (uint64_t) bound << 24
+        | (uint64_t) (move < 0 ? 255 : move) << 26
+        | (uint64_t) (generation & 255) << 34;
+}
+
+static inline int dataScore(uint64_t data) {
+    return (int16_t) (data & 0xffff);
+}
+
+static inline int dataDepth(uint64_t data) {
+    return (data >> 16) & 255;
+}
+
+static inline int dataBound(uint64_t data) {
+    return (data >> 24) & 3;
+}
+
+static inline int dataMove(uint64_t data) {
+    int move = (data >> 26) & 255;
+    return (move == 255) ? -1 : move;
+}
+
+static inline int dataGeneration(uint64_t data) {
+    return (data >> 34) & 255;
+}
+
+/*
+ * Make a table of the given size in megabytes.
+ */
+TranspositionTable::TranspositionTable(int megabytes) {
+    slots = NULL;
+    bucketMask = 0;
+    generation = 0;
+    resize(megabytes);
+}
+
+/*
+ * Destructor for the table.
+ */
+TranspositionTable::~TranspositionTable() {
+    free(slots);
+}
+
+/*
+ * Reallocates the table to the largest power-of-two number of buckets that
+ * fits in the given number of megabytes, and clears it.
+ */
+void TranspositionTable::resize(int megabytes) {
+    if (megabytes < 1) megabytes = 1;
+    uint64_t bytes = (uint64_t) megabytes << 20;
+    uint64_t buckets = 1;
+    while (buckets * 2 * TT_BUCKET_SIZE * sizeof(TTSlot) <= bytes)
+        buckets *= 2;
+
+    free(slots);
+    void *memory = NULL;
+    if (posix_memalign(&memory, 64, buckets * TT_BUCKET_SIZE * sizeof(TTSlot)))
+        memory = NULL;
+    slots = (TTSlot *) memory;
+    bucketMask = slots ? buckets - 1 : 0;
+    clear();
+}
+
+/*
+ * Forgets every stored position.
+ */
+void TranspositionTable::clear() {
+    if (slots)
+        memset(slots, 0, (bucketMask + 1) * TT_BUCKET_SIZE * sizeof(TTSlot));
+}
+
+/*
+ * Marks the start of a new search, so that entries from earlier searches are
+ * the first to be replaced.
+ */
+void TranspositionTable::newSearch() {
+    generation = (generation + 1) & 255;
+}
+
+/*
+ * Looks up a position. Returns true and fills in entry if it is stored.
+ */
+bool TranspositionTable::probe(uint64_t hash, TTEntry *entry) {
+    if (!slots) return false;
+    TTSlot *bucket = slots + (hash & bucketMask) * TT_BUCKET_SIZE;
+    for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+        uint64_t data = bucket[i].data;
+        if ((bucket[i].key ^ data) == hash && dataBound(data) != BOUND_NONE) {
+            entry->score = dataScore(data);
+            entry->depth = dataDepth(data);
+            entry->bound = dataBound(data);
+            entry->move = dataMove(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Stores a search result. A position already in its bucket is overwritten
+ * unless the stored search was deeper; otherwise the entry replaced is the
+ * shallowest one, preferring entries left over from earlier searches.
+ */
+void TranspositionTable::store(uint64_t hash, int depth, int bound,
+                               int score, int move) {
+    if (!slots) return;
+    TTSlot *bucket = slots + (hash & bucketMask) * TT_BUCKET_SIZE;
+    TTSlot *victim = bucket;
+    int victimValue = 1 << 30;
+    for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+        uint64_t data = bucket[i].data;
+        if ((bucket[i].key ^ data) == hash) {
+            if (depth < dataDepth(data) && bound != BOUND_EXACT) {
+                // Keep the deeper result, but remember a new best move.
+                if (move >= 0 && move != dataMove(data)) {
+                    data = pack(dataScore(data), dataDepth(data),
+                                dataBound(data), move, generation);
+                    bucket[i].key = hash ^ data;
+                    bucket[i].data = data;
+                }
+                return;
+            }
+            if (move < 0) move = dataMove(data);
+            victim = &bucket[i];
+            break;
+        }
+
+        int value = dataDepth(data);
+        if (dataGeneration(data) == generation) value += 256;
+        if (value < victimValue) {
+            victimValue = value;
+            victim = &bucket[i];
+        }
+    }
+
+    uint64_t data = pack(score, depth, bound, move, generation);
+    victim->key = hash ^ data;
+    victim->data = data;
+}
+
+/*
+ * Size of the table in megabytes.
+ */
+int TranspositionTable::sizeMB() {
+    return (int) (((bucketMask + 1) * TT_BUCKET_SIZE * sizeof(TTSlot)) >> 20);
+}
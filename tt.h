@@ -0,0 +1,60 @@
+#ifndef __TT_H__
+#define __TT_H__
+
+#include <stdint.h>
+
+// Default transposition table size in megabytes.
+#define DEFAULT_TT_MB 64
+
+// What a stored score says about the true score.
+#define BOUND_NONE 0
+#define BOUND_UPPER 1  // The search failed low: true score <= score
+#define BOUND_LOWER 2  // The search failed high: true score >= score
+#define BOUND_EXACT 3
+
+// Entries per bucket; a bucket is exactly one 64-byte cache line.
+#define TT_BUCKET_SIZE 4
+
+struct TTEntry {
+    int score;
+    int depth;
+    int bound;
+    int move;   // Best or refuting square, -1 if none
+};
+
+/*
+ * One packed table slot. data holds score, depth, bound, move and age; key
+ * holds the hash XORed with data, so an entry torn by two threads writing
+ * at once no longer matches its hash and is ignored rather than misread.
+ */
+struct TTSlot {
+    uint64_t key;
+    uint64_t data;
+};
+
+/*
+ * Fixed-size hash table of search results, indexed by Zobrist hash. The
+ * table needs no locks and can be shared between searching threads.
+ */
+class TranspositionTable {
+
+public:
+    TranspositionTable(int megabytes = DEFAULT_TT_MB);
+    ~TranspositionTable();
+
+    void resize(int megabytes);
+    void clear();
+    void newSearch();
+
+    bool probe(uint64_t hash, TTEntry *entry);
+    void store(uint64_t hash, int depth, int bound, int score, int move);
+
+    int sizeMB();
+
+private:
+    TTSlot *slots;
+    uint64_t bucketMask; // Number of buckets minus one; a power of 2
+    int generation;      // Bumped per search so old entries get replaced
+};
+
+#endif
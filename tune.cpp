@@ -0,0 +1,306 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <pthread.h>
+#include <vector>
+#include "common.h"
+#include "board.h"
+#include "eval.h"
+#include "record.h"
+
+// Positions per mini-batch: one weight update each.
+#define DEFAULT_BATCH 16384
+#define DEFAULT_EPOCHS 10
+#define DEFAULT_TUNE_THREADS 1
+
+// Each weight moves by the rate times the mean error of the positions that
+// use it. About 50 weights add up to every prediction, so a rate much past
+// 1/50 overshoots.
+#define DEFAULT_RATE 0.02
+
+// Evaluation points per disc of final score.
+#define DEFAULT_SCALE 8
+
+// Every VALIDATION_EVERY-th record is held out and only used to measure
+// the error on positions the weights weren't fitted to.
+#define VALIDATION_EVERY 16
+
+// Weights that add up to one prediction: one per feature, one per term.
+#define MAX_ACTIVE (NUM_FEATURES + NUM_TERMS)
+
+/*
+ * All weights of one phase are kept as floats in one block: the pattern
+ * tables in PatternType order, then the terms. The phases follow each
+ * other.
+ */
+static int tableOffset[NUM_PATTERN_TYPES];
+static int termOffset;
+static int phaseSize;
+static float *params;
+
+/*
+ * The share of one mini-batch a thread works on, and the gradient it
+ * accumulates: for each weight, the sum of error times input and the sum
+ * of input squared.
+ */
+struct Worker {
+    pthread_t thread;
+    const PositionRecord *positions;
+    int count;
+    long first;
+    double scale;
+    float *gradient;
+    float *curvature;
+    double trainError;
+    double validError;
+    long trainCount;
+    long validCount;
+};
+
+/*
+ * Lays out the float weights and fills them from the current ones.
+ */
+static void initParams() {
+    int offset = 0;
+    for (int type = 0; type < NUM_PATTERN_TYPES; type++) {
+        tableOffset[type] = offset;
+        int size = 1;
+        for (int i = 0; i < Eval::patternSize(type); i++) size *= 3;
+        offset += size;
+    }
+    termOffset = offset;
+    phaseSize = offset + NUM_TERMS;
+    params = new float[NUM_PHASES * phaseSize];
+
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+        float *p = params + phase * phaseSize;
+        for (int type = 0; type < NUM_PATTERN_TYPES; type++) {
+            short *w = Eval::weights(phase, type);
+            for (int i = tableOffset[type];
+                 i < (type + 1 < NUM_PATTERN_TYPES ? tableOffset[type + 1]
+                      : termOffset); i++)
+                p[i] = w[i - tableOffset[type]];
+        }
+        for (int t = 0; t < NUM_TERMS; t++)
+            p[termOffset + t] = Eval::termWeights(phase)[t];
+    }
+}
+
+/*
+ * Rounds a float weight to the nearest value a table entry can hold.
+ */
+static short toWeight(float p) {
+    float v = roundf(p);
+    return (v > 32767) ? 32767 : (v < -32767) ? -32767 : (short) v;
+}
+
+/*
+ * Rounds the float weights back into the engine's tables.
+ */
+static void storeParams() {
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+        float *p = params + phase * phaseSize;
+        for (int type = 0; type < NUM_PATTERN_TYPES; type++) {
+            short *w = Eval::weights(phase, type);
+            for (int i = tableOffset[type];
+                 i < (type + 1 < NUM_PATTERN_TYPES ? tableOffset[type + 1]
+                      : termOffset); i++)
+                w[i - tableOffset[type]] = toWeight(p[i]);
+        }
+        for (int t = 0; t < NUM_TERMS; t++)
+            Eval::termWeights(phase)[t] = toWeight(p[termOffset + t]);
+    }
+}
+
+/*
+ * Finds the weights that make up the evaluation of a position, as indices
+ * into params, and the input each is multiplied by. Returns how many.
+ */
+static int activeWeights(const PositionRecord *position, int *slots,
+                         float *inputs) {
+    Board board;
+    Side side = recordToBoard(position, &board);
+    Eval eval;
+    eval.setBoard(&board);
+    int base = Eval::phase(&board) * phaseSize;
+
+    // Pattern weights are from black's point of view.
+    float sign = (side == BLACK) ? 1 : -1;
+    int n = 0;
+    for (int f = 0; f < NUM_FEATURES; f++) {
+        slots[n] = base + tableOffset[Eval::featurePattern(f)]
+            + eval.index[f];
+        inputs[n++] = sign;
+    }
+    int values[NUM_TERMS];
+    Eval::terms(&board, side, values);
+    for (int t = 0; t < NUM_TERMS; t++) {
+        slots[n] = base + termOffset + t;
+        inputs[n++] = values[t];
+    }
+    return n;
+}
+
+/*
+ * Evaluates a thread's share of a batch, skipping records with no score.
+ * Held out positions only add to the validation error; the others add to
+ * the gradient.
+ */
+static void *workerMain(void *arg) {
+    Worker *w = (Worker *) arg;
+    int slots[MAX_ACTIVE];
+    float inputs[MAX_ACTIVE];
+    for (int i = 0; i < w->count; i++) {
+        const PositionRecord *position = &w->positions[i];
+        if (!(position->flags & RECORD_SCORE)) continue;
+        int n = activeWeights(position, slots, inputs);
+        float predicted = 0;
+        for (int k = 0; k < n; k++)
+            predicted += params[slots[k]] * inputs[k];
+        float error = predicted - position->score * w->scale;
+
+        if ((w->first + i) % VALIDATION_EVERY == 0) {
+            w->validError += error * error;
+            w->validCount++;
+            continue;
+        }
+        w->trainError += error * error;
+        w->trainCount++;
+        for (int k = 0; k < n; k++) {
+            w->gradient[slots[k]] += error * inputs[k];
+            w->curvature[slots[k]] += inputs[k] * inputs[k];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Fits the evaluation weights to labelled positions from gendata. Starts
+ * from the weights in --in (or the built-in ones), streams every file once
+ * per epoch in mini-batches split across threads, and moves each weight
+ * against its share of the squared error of the batch, scaled by how often
+ * the batch used it. The position files are mapped and read in place, so
+ * memory use doesn't grow with their size.
+ *
+ * Scores are fitted at --scale evaluation points per disc. The train and
+ * validation errors are printed in discs after each epoch, and the weights
+ * are written at the end in the format the engine loads at startup.
+ *
+ * usage: tune [--epochs N] [--batch N] [--threads N] [--rate R]
+ *             [--scale S] [--in FILE] [--out FILE] FILE...
+ */
+int main(int argc, char *argv[]) {
+    int epochs = DEFAULT_EPOCHS;
+    int batch = DEFAULT_BATCH;
+    int threads = DEFAULT_TUNE_THREADS;
+    double rate = DEFAULT_RATE;
+    double scale = DEFAULT_SCALE;
+    const char *inFile = WEIGHTS_FILE;
+    const char *outFile = WEIGHTS_FILE;
+    vector<const char *> files;
+    bool badArgs = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--epochs") && i + 1 < argc) {
+            epochs = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--batch") && i + 1 < argc) {
+            batch = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--scale") && i + 1 < argc) {
+            scale = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--in") && i + 1 < argc) {
+            inFile = argv[++i];
+        } else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+            outFile = argv[++i];
+        } else if (argv[i][0] != '-') {
+            files.push_back(argv[i]);
+        } else {
+            badArgs = true;
+        }
+    }
+    if (badArgs || files.empty() || batch < 1) {
+        fprintf(stderr, "usage: %s [--epochs N] [--batch N] [--threads N]"
+                " [--rate R] [--scale S]\n       [--in FILE] [--out FILE]"
+                " FILE...\n", argv[0]);
+        return 1;
+    }
+    if (threads < 1) threads = 1;
+
+    Eval::loadWeights(inFile);
+    initParams();
+    int numParams = NUM_PHASES * phaseSize;
+    vector<Worker> workers(threads);
+    for (int i = 0; i < threads; i++) {
+        workers[i].gradient = new float[numParams];
+        workers[i].curvature = new float[numParams];
+        workers[i].scale = scale;
+    }
+
+    for (int epoch = 1; epoch <= epochs; epoch++) {
+        double trainError = 0, validError = 0;
+        long trainCount = 0, validCount = 0;
+        for (unsigned int f = 0; f < files.size(); f++) {
+            PositionFile file;
+            if (!file.open(files[f])) {
+                fprintf(stderr, "could not read %s\n", files[f]);
+                return 1;
+            }
+            const PositionRecord *positions = file.records();
+            for (long first = 0; first < (long) file.size(); first += batch) {
+                int count = (file.size() - first < (size_t) batch)
+                    ? file.size() - first : batch;
+                int share = (count + threads - 1) / threads;
+                for (int i = 0; i < threads; i++) {
+                    Worker *w = &workers[i];
+                    int start = (i * share < count) ? i * share : count;
+                    w->positions = positions + first + start;
+                    w->count = (start + share < count) ? share
+                        : count - start;
+                    w->first = first + start;
+                    w->trainError = w->validError = 0;
+                    w->trainCount = w->validCount = 0;
+                    memset(w->gradient, 0, numParams * sizeof(float));
+                    memset(w->curvature, 0, numParams * sizeof(float));
+                    pthread_create(&w->thread, NULL, workerMain, w);
+                }
+                for (int i = 0; i < threads; i++)
+                    pthread_join(workers[i].thread, NULL);
+
+                // Sums the threads into the first and takes one step.
+                float *g = workers[0].gradient, *h = workers[0].curvature;
+                for (int i = 0; i < threads; i++) {
+                    Worker *w = &workers[i];
+                    trainError += w->trainError;
+                    validError += w->validError;
+                    trainCount += w->trainCount;
+                    validCount += w->validCount;
+                    if (i == 0) continue;
+                    for (int k = 0; k < numParams; k++) {
+                        g[k] += w->gradient[k];
+                        h[k] += w->curvature[k];
+                    }
+                }
+                for (int k = 0; k < numParams; k++)
+                    if (h[k] > 0) params[k] -= rate * g[k] / h[k];
+            }
+        }
+        printf("epoch %d: train %.3f discs (%ld), validation %.3f discs"
+               " (%ld)\n", epoch,
+               trainCount ? sqrt(trainError / trainCount) / scale : 0.0,
+               trainCount,
+               validCount ? sqrt(validError / validCount) / scale : 0.0,
+               validCount);
+        fflush(stdout);
+    }
+
+    storeParams();
+    if (!Eval::saveWeights(outFile)) {
+        fprintf(stderr, "could not write %s\n", outFile);
+        return 1;
+    }
+    printf("weights written to %s\n", outFile);
+    return 0;
+}
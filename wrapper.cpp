@@ -2,18 +2,153 @@
 #include <cstdlib>
 #include <cstring>
 #include "player.h"
+#include "analyze.h"
 using namespace std;
 
 int main(int argc, char *argv[]) {    
-    // Read in side the player is on.
-    if (argc != 2)  {
-        cerr << "usage: " << argv[0] << " side" << endl;
+    // Read in side the player is on, or --analyze and the file of
+    // positions, and any options after it.
+    int hashMB = DEFAULT_TT_MB;
+    int threads = 1;
+    int depth = 0;
+    int moveTime = 0;
+    double probCut = DEFAULT_PROBCUT_THRESHOLD;
+    bool ponder = false;
+    const char *statsFile = NULL;
+    const char *tracePrefix = NULL;
+    const char *weightsFile = NULL;
+    const char *bookFile = NULL;
+    const char *analyzeFile = NULL;
+    const char *recordsFile = NULL;
+    bool badArgs = (argc < 2);
+    int firstOption = 2;
+    if (argc >= 3 && !strcmp(argv[1], "--analyze")) {
+        analyzeFile = argv[2];
+        firstOption = 3;
+    }
+    for (int i = firstOption; i < argc; i++) {
+        if (!strcmp(argv[i], "--hash") && i + 1 < argc) {
+            hashMB = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--weights") && i + 1 < argc) {
+            weightsFile = argv[++i];
+        } else if (!strcmp(argv[i], "--book") && i + 1 < argc) {
+            bookFile = argv[++i];
+        } else if (!strcmp(argv[i], "--probcut") && i + 1 < argc) {
+            probCut = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--ponder") && !analyzeFile) {
+            ponder = true;
+        } else if (!strcmp(argv[i], "--stats") && i + 1 < argc
+                   && !analyzeFile) {
+            statsFile = argv[++i];
+        } else if (!strcmp(argv[i], "--trace") && i + 1 < argc
+                   && !analyzeFile) {
+            tracePrefix = argv[++i];
+        } else if (!strcmp(argv[i], "--depth") && i + 1 < argc
+                   && analyzeFile) {
+            depth = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--time") && i + 1 < argc
+                   && analyzeFile) {
+            moveTime = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--records") && i + 1 < argc
+                   && analyzeFile) {
+            recordsFile = argv[++i];
+        } else {
+            badArgs = true;
+        }
+    }
+    if (badArgs)  {
+        cerr << "usage: " << argv[0] << " side [--hash MB] [--threads N]"
+             << " [--weights FILE] [--book FILE] [--probcut T] [--ponder]"
+             << " [--stats FILE] [--trace PREFIX]" << endl;
+        cerr << "       " << argv[0] << " --analyze FILE [--depth N]"
+             << " [--time MS] [--hash MB] [--threads N] [--weights FILE]"
+             << " [--probcut T] [--records FILE]" << endl;
         exit(-1);
     }
     Side side = (!strcmp(argv[1], "Black")) ? BLACK : WHITE;
 
+    // Load trained evaluation weights; the default file is optional.
+    if (weightsFile) {
+        if (!Eval::loadWeights(weightsFile)) {
+            cerr << "could not load weights from " << weightsFile << endl;
+            exit(-1);
+        }
+    } else {
+        Eval::loadWeights(WEIGHTS_FILE);
+    }
+
+    // Calibrated cut parameters replace the built-in ones if there are any.
+    ProbCut::load(PROBCUT_FILE);
+
+    // Batch mode: search every position in the file ("-" for stdin), one
+    // per thread at a time, and write the results to stdout and, with
+    // --records, to a position file. The input is either text or a
+    // position file.
+    if (analyzeFile) {
+        Analyzer analyzer(threads, hashMB);
+        if (moveTime > 0) {
+            analyzer.moveTime = moveTime;
+            analyzer.depth = MAX_DEPTH;
+        }
+        if (depth > 0) analyzer.depth = depth;
+        analyzer.probCut = probCut;
+        PositionWriter records;
+        if (recordsFile) {
+            if (!records.open(recordsFile)) {
+                cerr << "could not open " << recordsFile << endl;
+                exit(-1);
+            }
+            analyzer.records = &records;
+        }
+
+        PositionFile positions;
+        if (strcmp(analyzeFile, "-") && positions.open(analyzeFile)) {
+            analyzer.run(&positions, stdout);
+        } else {
+            FILE *in = strcmp(analyzeFile, "-") ? fopen(analyzeFile, "r")
+                                                : stdin;
+            if (!in) {
+                cerr << "could not open " << analyzeFile << endl;
+                exit(-1);
+            }
+            analyzer.run(in, stdout);
+            if (in != stdin) fclose(in);
+        }
+        if (!records.close()) {
+            cerr << "could not write " << recordsFile << endl;
+            exit(-1);
+        }
+        return 0;
+    }
+
     // Initialize player.
     Player *player = new Player(side);
+    if (hashMB != DEFAULT_TT_MB) player->tt.resize(hashMB);
+    player->search.setThreads(threads);
+    player->search.probCut = probCut;
+    player->ponder = ponder;
+    player->tracePrefix = tracePrefix;
+    FILE *statsLog = NULL;
+    if (statsFile) {
+        statsLog = fopen(statsFile, "a");
+        if (!statsLog) {
+            cerr << "could not open " << statsFile << endl;
+            exit(-1);
+        }
+        player->statsLog = statsLog;
+    }
+
+    // Open the opening book; like the weights, the default file is optional.
+    if (bookFile) {
+        if (!player->book.open(bookFile)) {
+            cerr << "could not open book " << bookFile << endl;
+            exit(-1);
+        }
+    } else {
+        player->book.open(BOOK_FILE);
+    }
 
     // Tell java wrapper that we are done initializing.
     cout << "Init done" << endl;
@@ -21,7 +156,9 @@ int main(int argc, char *argv[]) {
     
     int moveX, moveY, msLeft;    
 
-    // Get opponent's move and time left for player each turn.
+    // Get opponent's move and time left for player each turn. With
+    // --ponder the player keeps searching on its own thread while this
+    // waits, and the next move stops or takes over that search.
     while (cin >> moveX >> moveY >> msLeft) {
         Move *opponentsMove = NULL;
         if (moveX >= 0 && moveY >= 0) {
@@ -43,5 +180,7 @@ int main(int argc, char *argv[]) {
         if (playersMove != NULL) delete playersMove; 
     }
 
+    delete player;
+    if (statsLog) fclose(statsLog);
     return 0;
 }